@@ -3,22 +3,38 @@ import struct
 from logging import getLogger, config
 import math
 from dataclasses import dataclass
+from pathlib import Path
 
 logger = getLogger(__name__)
 
 
+def column_size(height):
+    """bytes per glyph column: smallest of 1, 2, 4 and 8 holding height pixels. load_font picks the same from GLMT"""
+    for size in (1, 2, 4, 8):
+        if height <= size * 8:
+            return size
+    raise ValueError(f"glyph height {height} exceeds 64 pixels")
+
+
 class FourCC(bytes):
     pass
 
 
+# GLSP bitmaps in version 3 files start at multiple of this from the beginning of the file
+BITMAP_ALIGNMENT = 8
+
+
 class Chunk:
     chunk_id: FourCC = b"NULL"
 
     def __init__(self, data=b""):
         self.size = len(data)
         self.data = data
+        self.pos = 0
 
-    def dumps(self):
+    def dumps(self, pos=0):
+        """pos is the absolute position of this chunk in the file, which is recorded for the directory"""
+        self.pos = pos
         self.size = len(self.data)
         return struct.pack("<4sI", self.chunk_id, self.size) + self.data + (b"\x00" if self.size % 2 == 1 else b"")
 
@@ -40,30 +56,60 @@ class List(Chunk):
             children = []
         self.children: list[Chunk] = children
 
-    def dumps(self):
-        self.data = self.list_type
+    def dumps(self, pos=0):
+        data = bytearray(self.list_type)  # bytes += copies the whole list for every child
         for child in self.children:
-            self.data += child.dumps()
-        return super().dumps()
+            data += child.dumps(pos + 8 + len(data))
+        self.data = bytes(data)
+        return super().dumps(pos)
+
+
+class Junk(Chunk):
+    chunk_id = b"JUNK"
+
+    @classmethod
+    def for_alignment(cls, pos, offset, alignment):
+        """returns junk which moves data at pos + offset to the next multiple of alignment, or None"""
+        shift = (alignment - (pos + offset) % alignment) % alignment
+        if shift == 0:
+            return None
+        assert shift % 2 == 0
+        return cls(b"\x00" * ((shift - 8) % alignment))  # chunk header is 8 bytes
 
 
 class FontMetadata(Chunk):
     chunk_id = b"FTMT"
-    version = 2
 
-    def __init__(self, name: str = ""):
+    def __init__(self, name: str = "", version=4):
         super().__init__()
         self.namelen = 0
         self.name = name
+        self.version = version
 
-    def dumps(self):
+    def dumps(self, pos=0):
         name = self.name.encode("utf8")
         self.namelen = len(name)
         self.data = b""
         self.data += self.version.to_bytes(2, "little")
         self.data += self.namelen.to_bytes(2, "little")  # 数万字のフォント名など無かろう
         self.data += name
-        return super().dumps()
+        return super().dumps(pos)
+
+
+class Directory(Chunk):
+    """absolute positions of chunks, so that the reader doesn't have to walk the whole file"""
+
+    chunk_id = b"FDIR"
+
+    def __init__(self):
+        super().__init__()
+        self.entries: list[Chunk] = []
+
+    def dumps(self, pos=0):
+        self.data = len(self.entries).to_bytes(4, "little")
+        for entry in self.entries:
+            self.data += struct.pack("<4sII", entry.chunk_id, entry.pos, entry.size)
+        return super().dumps(pos)
 
 
 @dataclass
@@ -87,12 +133,109 @@ class CMAPTable(Chunk):
         super().__init__()
         self.chunk_id = f"CM{bytewidth}B".encode("utf8")
         if items is None:
-            self.items: list[CMAPItem] = []
+            items = []
+        self.items: list[CMAPItem] = items
+
+    def dumps(self, pos=0):
+        self.data = b"".join(item.to_bytes() for item in self.items)
+        return super().dumps(pos)
+
+
+@dataclass
+class CMAPRange:
+    first_codepoint: int
+    last_codepoint: int
+    first_glyphid: int
+
+    def to_bytes(self):
+        return struct.pack("<IIHH", self.first_codepoint, self.last_codepoint, self.first_glyphid, 0)
 
-    def dumps(self):
+    def items(self):
+        return [
+            CMAPItem(codepoint, self.first_glyphid + codepoint - self.first_codepoint)
+            for codepoint in range(self.first_codepoint, self.last_codepoint + 1)
+        ]
+
+
+class CMAPRanges(Chunk):
+    """runs of consecutive codepoints mapped to consecutive glyph ids, like format 12 of truetype cmap.
+    version 4 readers look them up before CMxB tables, which leave the items of the runs out"""
+
+    chunk_id = b"CMRG"
+    RANGE_SIZE = 12
+
+    def __init__(self, ranges=None):
+        super().__init__()
+        if ranges is None:
+            ranges = []
+        self.ranges: list[CMAPRange] = ranges
+
+    @staticmethod
+    def pays_off(item_count, range_count, rest_count):
+        """estimated binary search steps of a lookup, summed over every item, with and without ranges.
+        readers search ranges first, so the items left in the tables pay for both searches.
+        pack_font's ranges_pay_off uses the same integer estimate, so that the outputs stay identical"""
+        with_ranges = item_count * range_count.bit_length() + rest_count * rest_count.bit_length()
+        return with_ranges < item_count * item_count.bit_length()
+
+    @classmethod
+    def split(cls, items: list[CMAPItem]):
+        """items must be sorted by codepoint. returns runs which are smaller as a range than as items, and the rest.
+        no runs are returned if searching them first would make lookups slower"""
+        ranges = []
+        rest = []
+        begin = 0
+        for end in range(1, len(items) + 1):
+            if (
+                end < len(items)
+                and items[end].codepoint == items[end - 1].codepoint + 1
+                and items[end].glyphid == items[end - 1].glyphid + 1
+            ):
+                continue
+            run = items[begin:end]
+            if sum(len(item.to_bytes()) for item in run) > cls.RANGE_SIZE:
+                ranges.append(CMAPRange(run[0].codepoint, run[-1].codepoint, run[0].glyphid))
+            else:
+                rest += run
+            begin = end
+        if not cls.pays_off(len(items), len(ranges), len(rest)):
+            return [], list(items)
+        return ranges, rest
+
+    def dumps(self, pos=0):
+        self.data = b"".join(item.to_bytes() for item in self.ranges)
+        return super().dumps(pos)
+
+
+class CMAPHash(Chunk):
+    """open addressing hash table of all cmap items. linear probing, at most half full"""
+
+    chunk_id = b"CMHS"
+    EMPTY = 0xFFFFFFFF
+
+    def __init__(self, items=None):
+        super().__init__()
+        if items is None:
+            items = []
+        self.items: list[CMAPItem] = items
+
+    @staticmethod
+    def bucket_index(codepoint, bits):
+        return ((codepoint * 0x9E3779B1) & 0xFFFFFFFF) >> (32 - bits)
+
+    def dumps(self, pos=0):
+        bits = max(1, (len(self.items) * 2 - 1).bit_length())
+        buckets: list[CMAPItem | None] = [None] * (1 << bits)
         for item in self.items:
-            self.data += item.to_bytes()
-        return super().dumps()
+            index = self.bucket_index(item.codepoint, bits)
+            while buckets[index] is not None:
+                index = (index + 1) % len(buckets)
+            buckets[index] = item
+        empty = struct.pack("<IHH", self.EMPTY, 0, 0)
+        self.data = struct.pack("<II", len(buckets), 0) + b"".join(
+            empty if item is None else struct.pack("<IHH", item.codepoint, item.glyphid, 0) for item in buckets
+        )
+        return super().dumps(pos)
 
 
 class CMAP(List):
@@ -104,13 +247,41 @@ class CMAP(List):
         self.table_2byte = CMAPTable(2)
         self.table_3byte = CMAPTable(3)
         self.table_4byte = CMAPTable(4)
+        self.ranges: CMAPRanges | None = None
+        self.hash: CMAPHash | None = None
+
+    def tables(self) -> list[Chunk]:
+        result = [self.table_1byte, self.table_2byte, self.table_3byte, self.table_4byte]
+        if self.ranges is not None:
+            result.append(self.ranges)
+        if self.hash is not None:
+            result.append(self.hash)
+        return result
 
-    def dumps(self):
-        self.children.append(self.table_1byte)
-        self.children.append(self.table_2byte)
-        self.children.append(self.table_3byte)
-        self.children.append(self.table_4byte)
-        return super().dumps()
+    def items(self) -> list[CMAPItem]:
+        """every item including the ones in ranges, in codepoint order"""
+        result = self.table_1byte.items + self.table_2byte.items + self.table_3byte.items + self.table_4byte.items
+        if self.ranges is not None:
+            for cmap_range in self.ranges.ranges:
+                result += cmap_range.items()
+            result.sort(key=lambda item: item.codepoint)
+        return result
+
+    def coalesce_ranges(self):
+        """move runs of the tables into CMRG"""
+        if self.ranges is not None:
+            return
+        tables = [self.table_1byte, self.table_2byte, self.table_3byte, self.table_4byte]
+        ranges, rest = CMAPRanges.split(self.items())
+        self.ranges = CMAPRanges(ranges)
+        for table in tables:
+            table.items = []
+        for item in rest:
+            tables[len(item.to_bytes()) - 3].items.append(item)
+
+    def dumps(self, pos=0):
+        self.children = self.tables()
+        return super().dumps(pos)
 
 
 class GlyphShape(Chunk):
@@ -123,12 +294,15 @@ class GlyphShape(Chunk):
         self.width = width
         self.bitmaps = bitmaps
 
-    def dumps(self):
+    HEADER_SIZE = 8 + 6  # chunk header, firstgid, lastgid, width
+
+    def dumps(self, pos=0):
+        self.data = b""
         self.data += self.firstgid.to_bytes(2, "little", signed=False)
         self.data += self.lastgid.to_bytes(2, "little", signed=False)
         self.data += self.width.to_bytes(2, "little", signed=False)
         self.data += self.bitmaps
-        return super().dumps()
+        return super().dumps(pos)
 
 
 class GlyphMetaData(Chunk):
@@ -139,10 +313,11 @@ class GlyphMetaData(Chunk):
         self.max_width = max_width
         self.height = height
 
-    def dumps(self):
+    def dumps(self, pos=0):
+        self.data = b""
         self.data += self.max_width.to_bytes(2, "little", signed=False)
         self.data += self.height.to_bytes(2, "little", signed=False)
-        return super().dumps()
+        return super().dumps(pos)
 
 
 class ShapeList(List):
@@ -150,6 +325,19 @@ class ShapeList(List):
 
     def __init__(self):
         super().__init__()
+        self.align = False
+
+    def dumps(self, pos=0):
+        # JUNK chunks are inserted before shapes so that bitmaps are aligned. older readers ignore them
+        data = bytearray(self.list_type)
+        for child in self.children:
+            if self.align:
+                junk = Junk.for_alignment(pos + 8 + len(data), GlyphShape.HEADER_SIZE, BITMAP_ALIGNMENT)
+                if junk is not None:
+                    data += junk.dumps(pos + 8 + len(data))
+            data += child.dumps(pos + 8 + len(data))
+        self.data = bytes(data)
+        return Chunk.dumps(self, pos)
 
 
 class Glyph(List):
@@ -160,10 +348,9 @@ class Glyph(List):
         self.shapes = ShapeList()
         self.metadata = GlyphMetaData()
 
-    def dumps(self):
-        self.children.append(self.metadata)
-        self.children.append(self.shapes)
-        return super().dumps()
+    def dumps(self, pos=0):
+        self.children = [self.metadata, self.shapes]
+        return super().dumps(pos)
 
 
 class RIFFHeader(List):
@@ -176,14 +363,43 @@ class RIFFHeader(List):
 class FixedHeightFont(RIFFHeader):
     list_type = b"FHFT"
 
-    def __init__(self):
+    def __init__(self, version=4):
         super().__init__()
-        self.metadata = FontMetadata()
+        self.metadata = FontMetadata(version=version)
+        self.directory = Directory()
         self.cmap = CMAP()
         self.glyph = Glyph()
 
-    def dumps(self):
-        self.children.append(self.metadata)
-        self.children.append(self.cmap)
-        self.children.append(self.glyph)
-        return super().dumps()
+    def enable_cmap_hash(self):
+        """add CMHS to cmap. only version 3 and later readers use it. it holds the items of CMRG too"""
+        self.cmap.hash = CMAPHash(self.cmap.items())
+
+    def dump_sources(self, directory):
+        """write inputs of load_font's pack_font, which writes the same file as dump() without holding it in memory.
+        glyphs.bin is data of GLMT followed by data of every GLSP without padding.
+        cmap.bin is codepoint (u32), gid (u16) and 2 reserved bytes of every cmap item in codepoint order"""
+        directory = Path(directory)
+        directory.mkdir(parents=True, exist_ok=True)
+        with open(directory / "glyphs.bin", "wb") as outfile:
+            outfile.write(struct.pack("<HH", self.glyph.metadata.max_width, self.glyph.metadata.height))
+            for shape in self.glyph.shapes.children:
+                outfile.write(struct.pack("<HHH", shape.firstgid, shape.lastgid, shape.width))
+                outfile.write(shape.bitmaps)
+        with open(directory / "cmap.bin", "wb") as outfile:
+            for item in self.cmap.items():
+                outfile.write(struct.pack("<IHH", item.codepoint, item.glyphid, 0))
+
+    def dumps(self, pos=0):
+        if self.metadata.version < 3:
+            self.children = [self.metadata, self.cmap, self.glyph]
+            return super().dumps(pos)
+        if self.metadata.version >= 4:
+            self.cmap.coalesce_ranges()
+        self.children = [self.metadata, self.directory, self.cmap, self.glyph]
+        self.glyph.shapes.align = True
+        self.directory.entries = self.cmap.tables() + [self.glyph.metadata] + [
+            shape for shape in self.glyph.shapes.children if isinstance(shape, GlyphShape)
+        ]
+        # the directory has fixed size, so the first pass fixes positions of every chunk for the second one
+        super().dumps(pos)
+        return super().dumps(pos)
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""generate synthetic FixedHeightFont files and input texts for load_font benchmarks"""
+import argparse
+import math
+import random
+import tomllib
+from logging import getLogger, config
+from pathlib import Path
+
+import numpy as np
+
+import FixedHeightFontFormat as FHFT
+
+logger = getLogger(__name__)
+
+MAX_GLYPHS = 0xFFFF  # gid is 16 bit
+
+# codepoints by cmap table. CM4B stays empty, since codepoints beyond 3 bytes are not valid unicode
+CODEPOINTS_1BYTE = list(range(0x20, 0x7F)) + list(range(0xA0, 0x100))
+CODEPOINTS_2BYTE = [cp for cp in range(0x100, 0x10000) if not 0xD800 <= cp <= 0xDFFF]
+CODEPOINTS_3BYTE = range(0x10000, 0x110000)
+
+
+def pick_codepoints(rng: random.Random, count, supplementary_ratio):
+    """all of 1 byte codepoints first, then the rest split between 2 and 3 byte ones"""
+    result = CODEPOINTS_1BYTE[:count]
+    rest = count - len(result)
+    supplementary = max(round(rest * supplementary_ratio), rest - len(CODEPOINTS_2BYTE))
+    result += rng.sample(CODEPOINTS_2BYTE, rest - supplementary)
+    result += rng.sample(CODEPOINTS_3BYTE, supplementary)
+    return result
+
+
+def range_sizes(rng: random.Random, count, max_range_glyphs):
+    """glyph counts of GLSP chunks. log-uniform, so there are both tiny and huge chunks"""
+    sizes = []
+    while count > 0:
+        size = min(count, round(math.exp(rng.uniform(0, math.log(max_range_glyphs)))))
+        sizes.append(size)
+        count -= size
+    return sizes
+
+
+def shuffle_some(rng: random.Random, count, ratio):
+    """gids in codepoint order, with ratio of them shuffled. the rest make runs, like kana of real fonts"""
+    gids = list(range(count))
+    picked = sorted(rng.sample(range(count), round(count * ratio)))
+    shuffled = [gids[i] for i in picked]
+    rng.shuffle(shuffled)
+    for i, gid in zip(picked, shuffled):
+        gids[i] = gid
+    return gids
+
+
+def make_bitmaps(np_rng: np.random.Generator, glyph_count, width, height):
+    size = FHFT.column_size(height)
+    dtype = np.dtype(f"<u{size}")
+    columns = np_rng.integers(0, 1 << height, size=(glyph_count, width), dtype=np.uint64).astype(dtype)
+    # blank edges on some glyphs, so that both paths of blank column insertion are taken
+    columns[np_rng.random(glyph_count) < 0.3, 0] = 0
+    columns[np_rng.random(glyph_count) < 0.3, -1] = 0
+    return columns.tobytes()
+
+
+def generate_font(args):
+    rng = random.Random(args.seed)
+    np_rng = np.random.default_rng(args.seed)
+    result = FHFT.FixedHeightFont(args.format_version)
+    result.metadata.name = f"synthetic {args.glyphs} glyphs {args.height}px"
+
+    gid = 0
+    for size in range_sizes(rng, args.glyphs, args.max_range_glyphs):
+        width = rng.randint(args.min_width, args.max_width)
+        bitmaps = make_bitmaps(np_rng, size, width, args.height)
+        result.glyph.shapes.children.append(FHFT.GlyphShape(gid, gid + size - 1, width, bitmaps))
+        gid += size
+    logger.info("%d glyphs in %d GLSP chunks", gid, len(result.glyph.shapes.children))
+
+    codepoints = sorted(pick_codepoints(rng, args.glyphs, args.supplementary_ratio))
+    gids = shuffle_some(rng, args.glyphs, args.shuffle_ratio)
+    cmapitems = [FHFT.CMAPItem(cp, gid) for cp, gid in zip(codepoints, gids)]
+    tables = [result.cmap.table_1byte, result.cmap.table_2byte, result.cmap.table_3byte, result.cmap.table_4byte]
+    for item in cmapitems:
+        tables[len(item.to_bytes()) - 3].items.append(item)
+    logger.info("cmap items: %s", ", ".join(f"CM{i + 1}B {len(table.items)}" for i, table in enumerate(tables)))
+    if args.format_version >= 4:
+        result.cmap.coalesce_ranges()
+        logger.info(
+            "%d cmap ranges, items left: %d", len(result.cmap.ranges.ranges), sum(len(table.items) for table in tables)
+        )
+    if args.cmap_hash:
+        result.enable_cmap_hash()
+
+    result.glyph.metadata.max_width = args.max_width
+    result.glyph.metadata.height = args.height
+    return result, codepoints
+
+
+def generate_text(rng: random.Random, codepoints, args):
+    """codepoints of the font, with ascii_ratio of them from printable ascii, broken into lines"""
+    ascii_codepoints = [cp for cp in codepoints if cp < 0x7F]
+    chars = []
+    for i in range(args.text_codepoints):
+        if i % (args.line_length + 1) == args.line_length:
+            chars.append("\n")
+        elif ascii_codepoints and rng.random() < args.ascii_ratio:
+            chars.append(chr(rng.choice(ascii_codepoints)))
+        else:
+            chars.append(chr(rng.choice(codepoints)))
+    return "".join(chars)
+
+
+def init_argument_parser():
+    parser = argparse.ArgumentParser("synth.py", description="generate synthetic font and texts for benchmarks")
+    parser.add_argument("--dst", type=Path, help="destination font file", required=True)
+    parser.add_argument("--text", type=Path, help="also write utf8 text using glyphs of the font")
+    parser.add_argument("--dump-sources", type=Path, help="also write glyphs.bin and cmap.bin for pack_font here")
+    parser.add_argument(
+        "--log-level",
+        type=str,
+        help="log level",
+        default="INFO",
+        choices=["DEBUG", "INFO", "WARNING", "ERROR", "CRITICAL"],
+    )
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--glyphs", type=int, help=f"number of glyphs, up to {MAX_GLYPHS}", default=MAX_GLYPHS)
+    parser.add_argument("--height", type=int, help="glyph height in pixels, up to 64", default=16)
+    parser.add_argument("--min-width", type=int, default=4)
+    parser.add_argument("--max-width", type=int, default=16)
+    parser.add_argument("--max-range-glyphs", type=int, help="largest number of glyphs in a GLSP chunk", default=4096)
+    parser.add_argument("--shuffle-ratio", type=float, help="ratio of glyph ids out of codepoint order", default=0.5)
+    parser.add_argument(
+        "--supplementary-ratio", type=float, help="ratio of non ascii glyphs mapped beyond U+FFFF", default=0.25
+    )
+    parser.add_argument(
+        "--format-version", type=int, help="FixedHeightFont format version", default=4, choices=[2, 3, 4]
+    )
+    parser.add_argument("--cmap-hash", action="store_true", help="add precomputed cmap hash table (version 3 or later)")
+    parser.add_argument("--text-codepoints", type=int, help="length of the text including newlines", default=100000)
+    parser.add_argument("--line-length", type=int, help="codepoints per line of the text", default=40)
+    parser.add_argument("--ascii-ratio", type=float, help="ratio of printable ascii in the text", default=0.2)
+    return parser
+
+
+def main(args):
+    logger.setLevel(args.log_level)
+    if not 0 < args.glyphs <= MAX_GLYPHS:
+        raise SystemExit(f"--glyphs must be in 1..{MAX_GLYPHS}")
+    if not 0 < args.min_width <= args.max_width:
+        raise SystemExit("--min-width must be in 1..--max-width")
+    FHFT.column_size(args.height)  # reject heights load_font can't read early
+    font, codepoints = generate_font(args)
+    font.dump(args.dst)
+    logger.info("wrote %s", args.dst)
+    if args.dump_sources:
+        font.dump_sources(args.dump_sources)
+        logger.info("wrote sources to %s", args.dump_sources)
+    if args.text:
+        args.text.write_text(generate_text(random.Random(args.seed + 1), codepoints, args), encoding="utf8")
+        logger.info("wrote %s", args.text)
+
+
+if __name__ == "__main__":
+    with open(Path(__file__).parent / "log_config.toml", "rb") as infile:
+        config.dictConfig(tomllib.load(infile))
+    args = init_argument_parser().parse_args()
+    main(args)
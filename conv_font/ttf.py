@@ -28,8 +28,8 @@ class Glyph:
     gid: int = 0
 
 
-def load_ttf(path, out, out_xml, out_pbm):
-    result = FHFT.FixedHeightFont()
+def load_ttf(path, out, out_xml, out_pbm, version=4):
+    result = FHFT.FixedHeightFont(version)
 
     logger.info(path)
     logger.info(out)
@@ -102,7 +102,7 @@ def load_ttf(path, out, out_xml, out_pbm):
                         for col in buf:
                             print(f"{col:016b}", file=outfile)
 
-                imbuf = np.zeros((w), dtype=np.dtype("<H"))
+                imbuf = np.zeros((w), dtype=np.dtype(f"<u{FHFT.column_size(h)}"))
                 bitcount = 0
                 for y in range(h - 1, -1, -1):
                     for x in range(w):
@@ -118,7 +118,7 @@ def load_ttf(path, out, out_xml, out_pbm):
                         print("P1", file=outfile)
                         print(h, w, file=outfile)
                         for col in imbuf:
-                            print(f"{col:016b}", file=outfile)
+                            print(f"{col:0{h}b}", file=outfile)
     glyphs.sort(key=lambda item: item.width)
 
     if any(heights[i] != heights[i + 1] for i in range(len(heights) - 1)):
@@ -162,7 +162,7 @@ def load_ttf(path, out, out_xml, out_pbm):
             FHFT.GlyphShape(gs[0].gid, gs[-1].gid, w, b"".join(item.data for item in gs))
         )
     result.glyph.metadata.max_width = max(glyph.width for glyph in glyphs)
-    result.glyph.metadata.height = 16
+    result.glyph.metadata.height = heights[0]
     name_table = font["name"]
     result.metadata.name = name_table.getBestFullName()
     return result
@@ -181,6 +181,11 @@ def init_argument_parser():
     )
     parser.add_argument("--xml", action="store_true")
     parser.add_argument("--pbm", action="store_true")
+    parser.add_argument(
+        "--format-version", type=int, help="FixedHeightFont format version", default=4, choices=[2, 3, 4]
+    )
+    parser.add_argument("--cmap-hash", action="store_true", help="add precomputed cmap hash table (version 3 or later)")
+    parser.add_argument("--dump-sources", action="store_true", help="also write glyphs.bin and cmap.bin for pack_font")
     return parser
 
 
@@ -191,8 +196,12 @@ def main(args):
     # for pth in (SRCDIR / "data" / "KH-Dot").glob("*"):
     # for pth in (SRCDIR / "data" / "KH-Dot").glob("*Akihabara*"):
     #     load_ttf(pth, SRCDIR / "out" / (pth.stem))
-    font = load_ttf(args.src, args.dst, args.xml, args.pbm)
+    font = load_ttf(args.src, args.dst, args.xml, args.pbm, args.format_version)
+    if args.cmap_hash:
+        font.enable_cmap_hash()
     font.dump(args.dst / "font.fhft")
+    if args.dump_sources:
+        font.dump_sources(args.dst)
 
 
 if __name__ == "__main__":
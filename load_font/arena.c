@@ -0,0 +1,70 @@
+#include "arena.h"
+
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+size_t arena_size_of(size_t size) { return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1); }
+
+bool arena_init(Arena* arena, size_t capacity) {
+    *arena = (Arena){.base = NULL};
+    if (capacity == 0) {
+        return true;
+    }
+    void* base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        SIMPLE_LOG(FATAL, "failed to reserve %zu bytes for arena", capacity);
+        return false;
+    }
+    arena->base = base;
+    arena->capacity = capacity;
+    return true;
+}
+
+bool arena_reserve(Arena* arena, size_t capacity) {
+    if (capacity <= arena->capacity) {
+        return true;
+    }
+    if (arena->used != 0) {
+        SIMPLE_LOG(ERROR, "arena in use can't be remapped");
+        return false;
+    }
+    size_t peak = arena->peak;
+    arena_free(arena);
+    if (not arena_init(arena, capacity)) {
+        return false;
+    }
+    arena->peak = peak;
+    return true;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size_t aligned = arena_size_of(size);
+    if (aligned > arena->capacity - arena->used) {
+        SIMPLE_LOG(FATAL, "arena exhausted: %zu bytes requested, %zu of %zu used", size, arena->used,
+                   arena->capacity);
+        simple_log_stop_async();  // flush the line above before aborting
+        abort();
+    }
+    void* result = arena->base + arena->used;
+    arena->used += aligned;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return result;
+}
+
+void arena_reset(Arena* arena) { arena->used = 0; }
+
+void arena_free(Arena* arena) {
+    if (arena->base != NULL) {
+        munmap(arena->base, arena->capacity);
+    }
+    *arena = (Arena){.base = NULL};
+}
+
+void report_arena(FILE* out, const char* name, const Arena* arena) {
+    fprintf(out, "%s arena: peak %zu bytes, reserved %zu bytes (%.1f%%)\n", name, arena->peak, arena->capacity,
+            arena->capacity == 0 ? 0.0 : 100.0 * arena->peak / arena->capacity);
+}
@@ -0,0 +1,42 @@
+#ifndef LOAD_FONT_ARENA
+#define LOAD_FONT_ARENA
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+/*
+ * bump allocator over one anonymous mapping. pages are committed on first touch, so the reservation can be
+ * sized from upper bounds without costing memory. allocations are released all at once by arena_reset or
+ * arena_free. not thread safe: allocate on one thread, then hand the buffers to others
+ */
+typedef struct {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+    size_t peak;  // largest used since arena_init, resets included
+} Arena;
+
+// bytes an allocation of size takes in an arena. sum these to size a reservation
+size_t arena_size_of(size_t size);
+
+bool arena_init(Arena* arena, size_t capacity);
+// make room for capacity bytes. only an empty arena is remapped, since buffers in it would move
+bool arena_reserve(Arena* arena, size_t capacity);
+
+/**
+ * @brief allocate size bytes aligned to ARENA_ALIGNMENT
+ *
+ * @return pointer to the memory, which is not cleared. the reservation is sized up front from what its users
+ * allocate, so running out of it is a sizing bug: it's logged and the process aborts instead of returning NULL
+ */
+void* arena_alloc(Arena* arena, size_t size);
+// release every allocation at once. the mapping is kept for reuse
+void arena_reset(Arena* arena);
+void arena_free(Arena* arena);
+
+void report_arena(FILE* out, const char* name, const Arena* arena);
+
+#endif
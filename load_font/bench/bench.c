@@ -0,0 +1,393 @@
+#include <iso646.h>
+#include <pthread.h>
+#include <riff_reader.h>
+#include <simple_logging.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitmap_encoding.h"
+#include "font.h"
+#include "server.h"
+#include "timing.h"
+#include "utf8.h"
+
+#define DEFAULT_MIN_SECONDS 0.5
+
+void print_help() {
+    printf("load_font_bench: measure load_font on a text and fonts, and print results as json\n");
+    printf("usage: load_font_bench [options] text font...\n");
+    printf("options: \n");
+    printf("--min-time <seconds> run each measurement for at least <seconds>. default: %.1f\n", DEFAULT_MIN_SECONDS);
+    printf("-j/--threads <n>     threads of the parallel render measurement. default: 4\n");
+    printf("-h/--help            show this help\n");
+}
+
+// same walk as --riff-view, without printing. returns number of chunks
+static size_t walk_riff_list(RIFFCursor* cursor) {
+    size_t count = 0;
+    while (riff_cursor_next(cursor)) {
+        count++;
+        if (cursor->chunk.type == LIST) {
+            RIFFCursor list = riff_cursor_descend(cursor);
+            count += walk_riff_list(&list);
+        }
+    }
+    return count;
+}
+
+typedef struct {
+    const char* path;
+    size_t chunk_count;
+} RiffWalkBench;
+
+static void run_riff_walk(void* context) {
+    RiffWalkBench* bench = context;
+    FILE* file = fopen(bench->path, "rb");
+    RIFFHeaderInfo header = riff_open(file);
+    RIFFCursor cursor = riff_cursor_open(file, &header);
+    bench->chunk_count = walk_riff_list(&cursor);
+    fclose(file);
+}
+
+static void run_open(void* context) { font_close(font_open(context)); }
+
+typedef struct {
+    const LoadedFont* font;
+    const char32_t* chars;
+    size_t count;
+    size_t found;
+} LookupBench;
+
+static void run_lookup(void* context) {
+    LookupBench* bench = context;
+    bench->found = 0;
+    for (size_t i = 0; i < bench->count; i++) {
+        if (bench->chars[i] != '\n' && font_search_char(bench->font, bench->chars[i]) != FONT_GID_NOT_FOUND) {
+            bench->found++;
+        }
+    }
+}
+
+typedef struct {
+    const LoadedFont* font;
+    const char32_t* chars;
+    size_t utf32_strlen;
+    size_t thread_count;
+    Arena* arena;
+} RenderBench;
+
+static void run_render(void* context) {
+    RenderBench* bench = context;
+    RenderedText text;
+    arena_reset(bench->arena);
+    font_render_parallel(bench->font, bench->chars, bench->utf32_strlen, bench->thread_count, bench->arena, &text);
+}
+
+typedef struct {
+    const RenderedText* text;
+    size_t bytes;
+} OutputBench;
+
+// everything load_font writes for the text: raw bitmap, line tables and pbm
+static void run_output(void* context) {
+    OutputBench* bench = context;
+    char* buf = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&buf, &size);
+    write_encoded_bitmap(out, bench->text, RAW_ENCODING);
+    write_line_tables(out, bench->text);
+    write_pbm(out, bench->text);
+    fclose(out);
+    bench->bytes = size;
+    free(buf);
+}
+
+// non-empty lines of the text, escaped as server requests and terminated by '\n'
+typedef struct {
+    char* data;
+    size_t len;
+    size_t count;
+} ServerRequests;
+
+static void build_server_requests(const char* source, size_t len, ServerRequests* requests) {
+    requests->data = malloc(len * 2 + 1);  // every byte may be an escaped backslash
+    requests->len = 0;
+    requests->count = 0;
+    size_t line_begin = 0;
+    for (size_t i = 0; i <= len; i++) {
+        if (i < len && source[i] != '\n') {
+            if (source[i] == '\\') {
+                requests->data[requests->len++] = '\\';
+            }
+            requests->data[requests->len++] = source[i];
+        } else if (i > line_begin) {
+            requests->data[requests->len++] = '\n';
+            requests->count++;
+        }
+        if (i < len && source[i] == '\n') {
+            line_begin = i + 1;
+        }
+    }
+}
+
+typedef struct {
+    LoadedFont* font;
+    FILE* in;
+    FILE* out;
+} ServerThread;
+
+static void* run_server(void* arg) {
+    ServerThread* server = arg;
+    ServerOptions options = {.show_stats = false};
+    serve_stream(server->font, server->in, server->out, &options);
+    return NULL;
+}
+
+// read one response of the line framed protocol. false if the stream ended or the request failed
+static bool read_response(FILE* in, char** line, size_t* capacity) {
+    if (getline(line, capacity, in) == -1 || strncmp(*line, "OK ", 3) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < 3; i++) {  // bitmap, line widths and line ends
+        if (getline(line, capacity, in) == -1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+typedef struct {
+    size_t requests;
+    double requests_per_sec;
+    double latency_us[4];  // p50, p90, p99, max
+} ServerResult;
+
+static int compare_double(const void* lhs, const void* rhs) {
+    double a = *(const double*)lhs;
+    double b = *(const double*)rhs;
+    return (a > b) - (a < b);
+}
+
+// send the requests one at a time to serve_stream over a socket pair, and time each round trip on the client side
+static bool bench_server(LoadedFont* font, const ServerRequests* requests, double min_seconds, ServerResult* result) {
+    int fds[2];
+    if (requests->count == 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        SIMPLE_LOG(ERROR, "failed to connect to the server");
+        return false;
+    }
+    ServerThread server = {.font = font, .in = fdopen(fds[1], "r"), .out = fdopen(dup(fds[1]), "w")};
+    FILE* client_out = fdopen(fds[0], "w");
+    FILE* client_in = fdopen(dup(fds[0]), "r");
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_server, &server) != 0) {
+        SIMPLE_LOG(ERROR, "failed to create server thread");
+        fclose(client_out);
+        fclose(client_in);
+        fclose(server.in);
+        fclose(server.out);
+        return false;
+    }
+
+    size_t capacity = requests->count;
+    double* latencies = malloc(sizeof(double) * capacity);
+    size_t done = 0;
+    char* line = NULL;
+    size_t line_capacity = 0;
+    bool ok = true;
+    double begin = now_seconds();
+    double elapsed;
+    do {
+        const char* request = requests->data;
+        for (size_t i = 0; i < requests->count && ok; i++) {
+            const char* request_end = (const char*)memchr(request, '\n', requests->data + requests->len - request) + 1;
+            double sent = now_seconds();
+            fwrite(request, 1, request_end - request, client_out);
+            ok = fflush(client_out) == 0 && read_response(client_in, &line, &line_capacity);
+            if (done == capacity) {
+                capacity *= 2;
+                latencies = realloc(latencies, sizeof(double) * capacity);
+            }
+            latencies[done++] = (now_seconds() - sent) * 1e6;
+            request = request_end;
+        }
+        elapsed = now_seconds() - begin;
+    } while (ok && elapsed < min_seconds);
+    shutdown(fds[0], SHUT_WR);  // EOF for the server, which returns from serve_stream
+    pthread_join(thread, NULL);
+    fclose(server.in);
+    fclose(server.out);
+    fclose(client_out);
+    fclose(client_in);
+    free(line);
+    if (not ok) {
+        SIMPLE_LOG(ERROR, "server failed request %zu", done);
+        free(latencies);
+        return false;
+    }
+
+    qsort(latencies, done, sizeof(double), compare_double);
+    result->requests = done;
+    result->requests_per_sec = done / elapsed;
+    result->latency_us[0] = latencies[(done - 1) * 50 / 100];
+    result->latency_us[1] = latencies[(done - 1) * 90 / 100];
+    result->latency_us[2] = latencies[(done - 1) * 99 / 100];
+    result->latency_us[3] = latencies[done - 1];
+    free(latencies);
+    return true;
+}
+
+static void print_json_string(const char* str) {
+    putchar('"');
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            printf("\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            printf("\\u%04x", *str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+// separator is printed before the result, unless the font fails to open
+static bool bench_font(const char* path, const char32_t* chars, size_t utf32_strlen,
+                       const ServerRequests* requests, double min_seconds, size_t thread_count,
+                       const char* separator) {
+    LoadedFont* font = font_open(path);
+    if (font == NULL) {
+        return false;
+    }
+    RiffWalkBench riff_walk = {.path = path};
+    double riff_walk_seconds = seconds_per_run(run_riff_walk, &riff_walk, min_seconds);
+    double open_seconds = seconds_per_run(run_open, (void*)path, min_seconds);
+
+    LookupBench lookup = {.font = font, .chars = chars, .count = utf32_strlen - 1};
+    double lookup_seconds = seconds_per_run(run_lookup, &lookup, min_seconds);
+    Arena arena;
+    if (not arena_init(&arena, font_render_arena_size(font, utf32_strlen, thread_count))) {
+        font_close(font);
+        return false;
+    }
+    RenderBench render = {
+        .font = font, .chars = chars, .utf32_strlen = utf32_strlen, .thread_count = 1, .arena = &arena};
+    double render_seconds = seconds_per_run(run_render, &render, min_seconds);
+    render.thread_count = thread_count;
+    double parallel_render_seconds = seconds_per_run(run_render, &render, min_seconds);
+
+    RenderedText text;
+    arena_reset(&arena);
+    font_render(font, chars, utf32_strlen, &arena, &text);
+    OutputBench output = {.text = &text};
+    double output_seconds = seconds_per_run(run_output, &output, min_seconds);
+    ServerResult server;
+    if (not bench_server(font, requests, min_seconds, &server)) {
+        arena_free(&arena);
+        font_close(font);
+        return false;
+    }
+
+    printf("%s    {\"path\": ", separator);
+    print_json_string(path);
+    printf(", \"version\": %u, \"indexed\": %s, \"cmap_hash\": %s, \"cmap_ranges\": %zu, \"height\": %u,\n",
+           font->version, font->indexed ? "true" : "false", font->cmap_hash.present ? "true" : "false",
+           font->cmap_ranges.count, font->height);
+    printf("     \"glyph_ranges\": %zu,", font->glyph_range_count);
+    printf(" \"riff_chunks\": %zu, \"riff_walk_us\": %.3f, \"open_us\": %.3f,\n", riff_walk.chunk_count,
+           riff_walk_seconds * 1e6, open_seconds * 1e6);
+    printf("     \"lookups\": %zu, \"lookups_per_sec\": %.0f, \"glyphs_per_sec\": %.0f,", lookup.count,
+           lookup.count / lookup_seconds, lookup.found / render_seconds);
+    printf(" \"parallel_glyphs_per_sec\": %.0f,\n", lookup.found / parallel_render_seconds);
+    printf("     \"font_arena_bytes\": %zu, \"render_arena_peak_bytes\": %zu,", font->arena.peak, arena.peak);
+    printf(" \"columns\": %zu, \"output_bytes\": %zu, \"output_bytes_per_sec\": %.0f,\n", text.bitmap_len,
+           output.bytes, output.bytes / output_seconds);
+    printf("     \"server_requests\": %zu, \"server_requests_per_sec\": %.0f,", server.requests,
+           server.requests_per_sec);
+    printf(" \"server_latency_us\": {\"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}}",
+           server.latency_us[0], server.latency_us[1], server.latency_us[2], server.latency_us[3]);
+    arena_free(&arena);
+    font_close(font);
+    return true;
+}
+
+static char* read_file(const char* path, size_t* len) {
+    FILE* file = fopen(path, "rb");
+    struct stat file_stat;
+    if (file == NULL || fstat(fileno(file), &file_stat) == -1) {
+        if (file) {
+            fclose(file);
+        }
+        return NULL;
+    }
+    *len = file_stat.st_size;
+    char* buf = malloc(*len + 1);
+    *len = fread(buf, 1, *len, file);
+    buf[*len] = '\0';
+    fclose(file);
+    return buf;
+}
+
+int main(int argc, char** argv) {
+    double min_seconds = DEFAULT_MIN_SECONDS;
+    size_t thread_count = 4;
+    int first_positional = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help();
+            return 0;
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_seconds = strtod(argv[++i], NULL);
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            thread_count = strtoul(argv[++i], NULL, 10);
+        } else {
+            first_positional = i;
+            break;
+        }
+    }
+    if (argc - first_positional < 2) {
+        SIMPLE_LOG(FATAL, "text and at least one font are required");
+        return 1;
+    }
+
+    const char* text_path = argv[first_positional];
+    size_t len;
+    char* source = read_file(text_path, &len);
+    if (source == NULL) {
+        SIMPLE_LOG(FATAL, "failed to read text file");
+        return 1;
+    }
+    char32_t* chars = malloc(sizeof(char32_t) * (len + 1));
+    size_t written;
+    size_t error_offset;
+    if (not utf8_transcode(source, len, chars, &written, &error_offset)) {
+        SIMPLE_LOG(FATAL, "invalid utf8 sequence at byte %zu of the text", error_offset);
+        return 1;
+    }
+    chars[written] = '\0';
+    ServerRequests requests;
+    build_server_requests(source, len, &requests);
+    free(source);
+
+    printf("{\"text\": ");
+    print_json_string(text_path);
+    printf(", \"codepoints\": %zu, \"min_seconds\": %g, \"threads\": %zu,\n \"fonts\": [\n", written, min_seconds,
+           thread_count);
+    int exit_status = 0;
+    const char* separator = "";
+    for (int i = first_positional + 1; i < argc; i++) {
+        if (bench_font(argv[i], chars, written + 1, &requests, min_seconds, thread_count, separator)) {
+            separator = ",\n";
+        } else {
+            exit_status = 1;
+        }
+    }
+    printf("\n]}\n");
+    free(requests.data);
+    free(chars);
+    return exit_status;
+}
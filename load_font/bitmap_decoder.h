@@ -0,0 +1,45 @@
+#ifndef LOAD_FONT_BITMAP_DECODER
+#define LOAD_FONT_BITMAP_DECODER
+/*
+ * header-only decoders for bitmaps written by load_font --encoding.
+ * they never allocate, so they can be copied to the device as is, together with bitmap_decoder_columns.h.
+ * every decoder is defined per column type and suffixed with the column width in bits,
+ * e.g. BitmapRLEDecoder_16, bitmap_rle_init_16 and bitmap_rle_decode_16 for glyphs of 9 to 16 pixels
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+// rle control byte, followed by payload. columns are little endian and as wide as the column type
+#define BITMAP_RLE_LITERAL 0x00  // 0x00-0x7f: count - 1. followed by count columns
+#define BITMAP_RLE_ZEROS 0x80    // 0x80-0xbf: count - 1. blank columns, no payload
+#define BITMAP_RLE_REPEAT 0xc0   // 0xc0-0xff: count - 2. followed by one column repeated count times
+#define BITMAP_RLE_MAX_LITERAL 128
+#define BITMAP_RLE_MAX_ZEROS 64
+#define BITMAP_RLE_MAX_REPEAT 65
+
+/*
+ * dictionary encoding stores unique columns in bitmap_dict and one index per column in bitmap_indices.
+ * columns can be decoded from any position
+ */
+
+#define COLUMN_T uint8_t
+#define COLUMN_FN(name) name##_8
+#include "bitmap_decoder_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint16_t
+#define COLUMN_FN(name) name##_16
+#include "bitmap_decoder_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint32_t
+#define COLUMN_FN(name) name##_32
+#include "bitmap_decoder_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint64_t
+#define COLUMN_FN(name) name##_64
+#include "bitmap_decoder_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#endif
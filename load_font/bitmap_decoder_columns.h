@@ -0,0 +1,103 @@
+/*
+ * rle and dict decoders for one column type.
+ * bitmap_decoder.h includes this once per column type with these defined, so there is no include guard:
+ *   COLUMN_T         uint8_t, uint16_t, uint32_t or uint64_t
+ *   COLUMN_FN(name)  name suffixed with the column width
+ */
+
+typedef struct {
+    const uint8_t* cursor;
+    const uint8_t* end;
+    uint8_t kind;      // BITMAP_RLE_LITERAL, BITMAP_RLE_ZEROS or BITMAP_RLE_REPEAT
+    size_t remaining;  // columns left in the current run
+    COLUMN_T column;   // column of BITMAP_RLE_ZEROS and BITMAP_RLE_REPEAT runs
+} COLUMN_FN(BitmapRLEDecoder);
+
+/**
+ * @brief start decoding rle data
+ *
+ * @param data bitmap_rle, or bitmap_rle + line_rle_offsets[i] to start at line i
+ * @param size bytes of data to decode
+ */
+static inline void COLUMN_FN(bitmap_rle_init)(COLUMN_FN(BitmapRLEDecoder)* decoder, const uint8_t* data, size_t size) {
+    decoder->cursor = data;
+    decoder->end = data + size;
+    decoder->kind = BITMAP_RLE_LITERAL;
+    decoder->remaining = 0;
+    decoder->column = 0;
+}
+
+static inline COLUMN_T COLUMN_FN(bitmap_rle_read_column)(const uint8_t* cursor) {
+    COLUMN_T column = 0;
+    for (size_t i = 0; i < sizeof(COLUMN_T); i++) {
+        column |= (COLUMN_T)cursor[i] << (8 * i);
+    }
+    return column;
+}
+
+/**
+ * @brief decode next columns. can be called repeatedly to stream columns into a small buffer
+ *
+ * @return number of columns written into out, at most capacity. 0 when the data is exhausted
+ */
+static inline size_t COLUMN_FN(bitmap_rle_decode)(COLUMN_FN(BitmapRLEDecoder)* decoder, COLUMN_T* out,
+                                                  size_t capacity) {
+    size_t written = 0;
+    while (written < capacity) {
+        if (decoder->remaining == 0) {
+            if (decoder->cursor == decoder->end) {
+                break;
+            }
+            uint8_t control = *decoder->cursor++;
+            if (control < BITMAP_RLE_ZEROS) {
+                decoder->kind = BITMAP_RLE_LITERAL;
+                decoder->remaining = control - BITMAP_RLE_LITERAL + 1;
+            } else if (control < BITMAP_RLE_REPEAT) {
+                decoder->kind = BITMAP_RLE_ZEROS;
+                decoder->remaining = control - BITMAP_RLE_ZEROS + 1;
+                decoder->column = 0;
+            } else {
+                decoder->kind = BITMAP_RLE_REPEAT;
+                decoder->remaining = control - BITMAP_RLE_REPEAT + 2;
+                decoder->column = COLUMN_FN(bitmap_rle_read_column)(decoder->cursor);
+                decoder->cursor += sizeof(COLUMN_T);
+            }
+        }
+        size_t count = decoder->remaining < capacity - written ? decoder->remaining : capacity - written;
+        if (decoder->kind == BITMAP_RLE_LITERAL) {
+            for (size_t i = 0; i < count; i++) {
+                out[written + i] = COLUMN_FN(bitmap_rle_read_column)(decoder->cursor);
+                decoder->cursor += sizeof(COLUMN_T);
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                out[written + i] = decoder->column;
+            }
+        }
+        written += count;
+        decoder->remaining -= count;
+    }
+    return written;
+}
+
+// the number after bitmap_dict_decode is the width of the indices, the suffix that of the columns
+static inline void COLUMN_FN(bitmap_dict_decode8)(const COLUMN_T* dict, const uint8_t* indices, size_t count,
+                                                  COLUMN_T* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = dict[indices[i]];
+    }
+}
+
+static inline void COLUMN_FN(bitmap_dict_decode16)(const COLUMN_T* dict, const uint16_t* indices, size_t count,
+                                                   COLUMN_T* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = dict[indices[i]];
+    }
+}
+
+static inline void COLUMN_FN(bitmap_dict_decode32)(const COLUMN_T* dict, const uint32_t* indices, size_t count,
+                                                   COLUMN_T* out) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = dict[indices[i]];
+    }
+}
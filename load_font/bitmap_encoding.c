@@ -0,0 +1,348 @@
+#include "bitmap_encoding.h"
+
+#include <inttypes.h>
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap_decoder.h"
+#include "timing.h"
+
+#define DISPLAY_BUFFER_COLUMNS 64  // decode in chunks like a device streaming into its display buffer
+
+bool parse_bitmap_encoding(const char* str, BitmapEncoding* encoding) {
+    if (strcmp(str, "raw") == 0) {
+        *encoding = RAW_ENCODING;
+    } else if (strcmp(str, "rle") == 0) {
+        *encoding = RLE_ENCODING;
+    } else if (strcmp(str, "dict") == 0) {
+        *encoding = DICT_ENCODING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    const RenderedText* text;
+    const RLEBitmap* rle;
+    const DictBitmap* dict;
+    union {
+        const uint8_t* indices8;  // dict indices narrowed to index_size
+        const uint16_t* indices16;
+    };
+    void* decoded;  // bitmap_len columns. compared with the bitmap after timing
+    size_t decoded_len;
+} DecodeBench;
+
+static size_t display_chunk(size_t len, size_t pos) {
+    return len - pos < DISPLAY_BUFFER_COLUMNS ? len - pos : DISPLAY_BUFFER_COLUMNS;
+}
+
+static size_t hash_column(uint64_t column) { return (column * 11400714819323198485u) >> 32; }  // fibonacci
+
+#define COLUMN_T uint8_t
+#define COLUMN_FN(name) name##_8
+#include "bitmap_encoding_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint16_t
+#define COLUMN_FN(name) name##_16
+#include "bitmap_encoding_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint32_t
+#define COLUMN_FN(name) name##_32
+#include "bitmap_encoding_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint64_t
+#define COLUMN_FN(name) name##_64
+#include "bitmap_encoding_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+
+void rle_encode(const RenderedText* text, RLEBitmap* result) {
+    // a literal of one column takes the control byte and the column at worst
+    result->data = malloc((1 + text->column_size) * text->bitmap_len + 1);
+    result->size = 0;
+    result->line_offsets = malloc(sizeof(size_t) * (text->linecount + 1));
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            rle_encode_lines_8(text, result);
+            break;
+        case sizeof(uint16_t):
+            rle_encode_lines_16(text, result);
+            break;
+        case sizeof(uint32_t):
+            rle_encode_lines_32(text, result);
+            break;
+        default:
+            rle_encode_lines_64(text, result);
+            break;
+    }
+}
+
+void free_rle_bitmap(RLEBitmap* bitmap) {
+    free(bitmap->data);
+    free(bitmap->line_offsets);
+    bitmap->data = NULL;
+    bitmap->line_offsets = NULL;
+    bitmap->size = 0;
+}
+
+void dict_encode(const RenderedText* text, DictBitmap* result) {
+    result->column_size = text->column_size;
+    result->indices = malloc(sizeof(uint32_t) * (text->bitmap_len + 1));
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            dict_encode_8(text, result);
+            break;
+        case sizeof(uint16_t):
+            dict_encode_16(text, result);
+            break;
+        case sizeof(uint32_t):
+            dict_encode_32(text, result);
+            break;
+        default:
+            dict_encode_64(text, result);
+            break;
+    }
+    if (result->dict_len <= UINT8_MAX + 1) {
+        result->index_size = sizeof(uint8_t);
+    } else if (result->dict_len <= UINT16_MAX + 1) {
+        result->index_size = sizeof(uint16_t);
+    } else {
+        result->index_size = sizeof(uint32_t);
+    }
+}
+
+size_t dict_bitmap_size(const DictBitmap* bitmap, size_t bitmap_len) {
+    return bitmap->column_size * bitmap->dict_len + bitmap->index_size * bitmap_len;
+}
+
+void free_dict_bitmap(DictBitmap* bitmap) {
+    free(bitmap->dict);
+    free(bitmap->indices);
+    bitmap->dict = NULL;
+    bitmap->indices = NULL;
+    bitmap->dict_len = 0;
+}
+
+// column i of columns of column_size bytes, widened for printing
+static uint64_t column_at(const void* columns, size_t column_size, size_t i) {
+    switch (column_size) {
+        case sizeof(uint8_t):
+            return ((const uint8_t*)columns)[i];
+        case sizeof(uint16_t):
+            return ((const uint16_t*)columns)[i];
+        case sizeof(uint32_t):
+            return ((const uint32_t*)columns)[i];
+        default:
+            return ((const uint64_t*)columns)[i];
+    }
+}
+
+static const char* index_type(size_t index_size) {
+    switch (index_size) {
+        case sizeof(uint8_t):
+            return "uint8_t";
+        case sizeof(uint16_t):
+            return "uint16_t";
+        default:
+            return "uint32_t";
+    }
+}
+
+// expanded once per column type, so the loops don't branch on the column size
+#define WRITE_RAW_COLUMNS(outfile, columns, len, format)   \
+    for (size_t i = 0; i < (len); i++) {                   \
+        fprintf(outfile, "0x%" format ", ", (columns)[i]); \
+    }
+
+#define WRITE_PBM_ROWS(pbmfile, columns, len, shift, row_bytes) \
+    for (size_t i = 0; i < (len); i++) {                        \
+        uint64_t row = (uint64_t)(columns)[i] << (shift);       \
+        for (size_t byte = (row_bytes); byte > 0; byte--) {     \
+            fputc((row >> (8 * (byte - 1))) & 0xff, pbmfile);   \
+        }                                                       \
+    }
+
+static void write_raw_bitmap(FILE* outfile, const RenderedText* text) {
+    fprintf(outfile, "uint%zu_t bitmap[] = {\n    ", text->column_size * 8);
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            WRITE_RAW_COLUMNS(outfile, text->bitmap8, text->bitmap_len, PRIX8);
+            break;
+        case sizeof(uint16_t):
+            WRITE_RAW_COLUMNS(outfile, text->bitmap16, text->bitmap_len, PRIX16);
+            break;
+        case sizeof(uint32_t):
+            WRITE_RAW_COLUMNS(outfile, text->bitmap32, text->bitmap_len, PRIX32);
+            break;
+        default:
+            WRITE_RAW_COLUMNS(outfile, text->bitmap64, text->bitmap_len, PRIX64);
+            break;
+    }
+    fprintf(outfile, "\n};\n");
+}
+
+void write_pbm(FILE* pbmfile, const RenderedText* text) {
+    // each column becomes a row of the image, top pixel of the column on the left
+    size_t row_bytes = (text->height + 7) / 8;
+    size_t shift = row_bytes * 8 - text->height;
+    fprintf(pbmfile, "P4\n%d %zu\n", text->height, text->bitmap_len);
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            WRITE_PBM_ROWS(pbmfile, text->bitmap8, text->bitmap_len, shift, row_bytes);
+            break;
+        case sizeof(uint16_t):
+            WRITE_PBM_ROWS(pbmfile, text->bitmap16, text->bitmap_len, shift, row_bytes);
+            break;
+        case sizeof(uint32_t):
+            WRITE_PBM_ROWS(pbmfile, text->bitmap32, text->bitmap_len, shift, row_bytes);
+            break;
+        default:
+            WRITE_PBM_ROWS(pbmfile, text->bitmap64, text->bitmap_len, shift, row_bytes);
+            break;
+    }
+}
+
+bool write_encoded_bitmap(FILE* outfile, const RenderedText* text, BitmapEncoding encoding) {
+    switch (encoding) {
+        case RAW_ENCODING:
+            write_raw_bitmap(outfile, text);
+            return true;
+        case RLE_ENCODING: {
+            RLEBitmap rle;
+            rle_encode(text, &rle);
+            fprintf(outfile, "uint8_t bitmap_rle[] = {\n    ");
+            for (size_t i = 0; i < rle.size; i++) {
+                fprintf(outfile, "0x%X, ", rle.data[i]);
+            }
+            fprintf(outfile, "\n};\n");
+            fprintf(outfile, "size_t bitmap_len = %zu;\n", text->bitmap_len);
+            fprintf(outfile, "size_t line_rle_offsets[] = {\n    ");
+            for (size_t i = 0; i < text->linecount; i++) {
+                fprintf(outfile, "%zu, ", rle.line_offsets[i]);
+            }
+            fprintf(outfile, "\n};\n");
+            free_rle_bitmap(&rle);
+            return true;
+        }
+        case DICT_ENCODING: {
+            DictBitmap dict;
+            dict_encode(text, &dict);
+            size_t raw_size = text->column_size * text->bitmap_len;
+            if (dict_bitmap_size(&dict, text->bitmap_len) >= raw_size) {
+                // still written as dict, so that the symbols of the output don't depend on the text
+                SIMPLE_LOG(WARNING, "dict encoding takes %zu bytes, more than raw %zu bytes",
+                           dict_bitmap_size(&dict, text->bitmap_len), raw_size);
+            }
+            fprintf(outfile, "uint%zu_t bitmap_dict[] = {\n    ", text->column_size * 8);
+            for (size_t i = 0; i < dict.dict_len; i++) {
+                fprintf(outfile, "0x%" PRIX64 ", ", column_at(dict.dict, dict.column_size, i));
+            }
+            fprintf(outfile, "\n};\n");
+            fprintf(outfile, "%s bitmap_indices[] = {\n    ", index_type(dict.index_size));
+            for (size_t i = 0; i < text->bitmap_len; i++) {
+                fprintf(outfile, "%" PRIu32 ", ", dict.indices[i]);
+            }
+            fprintf(outfile, "\n};\n");
+            free_dict_bitmap(&dict);
+            return true;
+        }
+    }
+    return false;
+}
+
+void write_line_tables(FILE* outfile, const RenderedText* text) {
+    fprintf(outfile, "size_t line_widths[] = {\n    ");
+    for (size_t i = 0; i < text->linecount; i++) {
+        fprintf(outfile, "%zu, ", text->line_widths[i]);
+    }
+    fprintf(outfile, "\n};\n");
+    fprintf(outfile, "size_t line_ends[] = {\n    ");
+    for (size_t i = 0; i < text->linecount; i++) {
+        fprintf(outfile, "%zu, ", text->line_ends[i]);
+    }
+    fprintf(outfile, "\n};\n");
+}
+
+static void decode_raw(void* context) {
+    DecodeBench* bench = context;
+    const RenderedText* text = bench->text;
+    for (size_t i = 0; i < text->bitmap_len; i += DISPLAY_BUFFER_COLUMNS) {
+        memcpy((uint8_t*)bench->decoded + text->column_size * i, (const uint8_t*)text->bitmap + text->column_size * i,
+               text->column_size * display_chunk(text->bitmap_len, i));
+    }
+    bench->decoded_len = text->bitmap_len;
+}
+
+// time decoder over the whole bitmap, and check that it reproduces the bitmap
+static bool time_decoder(FILE* out, const char* name, size_t bytes, TimedBody decoder, DecodeBench* bench) {
+    const RenderedText* text = bench->text;
+    size_t raw_bytes = text->column_size * text->bitmap_len;
+    memset(bench->decoded, 0, raw_bytes);
+    double seconds = seconds_per_run(decoder, bench, TIMING_MIN_SECONDS);
+    fprintf(out, "%-5s %10zu bytes %7.2f%% decode %8.1f Mcolumns/s\n", name, bytes, 100.0 * bytes / raw_bytes,
+            text->bitmap_len / seconds / 1e6);
+    return bench->decoded_len == text->bitmap_len && memcmp(bench->decoded, text->bitmap, raw_bytes) == 0;
+}
+
+void report_bitmap_encodings(FILE* out, const RenderedText* text) {
+    size_t raw_bytes = text->column_size * text->bitmap_len;
+    if (raw_bytes == 0) {
+        fprintf(out, "bitmap is empty\n");
+        return;
+    }
+    RLEBitmap rle;
+    rle_encode(text, &rle);
+    DictBitmap dict;
+    dict_encode(text, &dict);
+    // indices as written, so the decoders read what the device would
+    void* indices = NULL;
+    if (dict.index_size == sizeof(uint8_t)) {
+        uint8_t* indices8 = malloc(text->bitmap_len);
+        for (size_t i = 0; i < text->bitmap_len; i++) {
+            indices8[i] = dict.indices[i];
+        }
+        indices = indices8;
+    } else if (dict.index_size == sizeof(uint16_t)) {
+        uint16_t* indices16 = malloc(sizeof(uint16_t) * text->bitmap_len);
+        for (size_t i = 0; i < text->bitmap_len; i++) {
+            indices16[i] = dict.indices[i];
+        }
+        indices = indices16;
+    }
+    DecodeBench bench = {.text = text, .rle = &rle, .dict = &dict, .indices8 = indices, .decoded = malloc(raw_bytes)};
+
+    TimedBody decode_rle = decode_rle_64;
+    TimedBody decode_dict = decode_dict_64;
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            decode_rle = decode_rle_8;
+            decode_dict = decode_dict_8;
+            break;
+        case sizeof(uint16_t):
+            decode_rle = decode_rle_16;
+            decode_dict = decode_dict_16;
+            break;
+        case sizeof(uint32_t):
+            decode_rle = decode_rle_32;
+            decode_dict = decode_dict_32;
+            break;
+    }
+    time_decoder(out, "raw", raw_bytes, decode_raw, &bench);
+    bool rle_matches = time_decoder(out, "rle", rle.size + sizeof(size_t) * text->linecount, decode_rle, &bench);
+    bool dict_matches = time_decoder(out, "dict", dict_bitmap_size(&dict, text->bitmap_len), decode_dict, &bench);
+    if (dict_bitmap_size(&dict, text->bitmap_len) >= raw_bytes) {
+        fprintf(out, "dict is not smaller than raw\n");
+    }
+    fprintf(out, "round trip: rle %s, dict %s\n", rle_matches ? "ok" : "MISMATCH", dict_matches ? "ok" : "MISMATCH");
+    free(bench.decoded);
+    free(indices);
+    free_dict_bitmap(&dict);
+    free_rle_bitmap(&rle);
+}
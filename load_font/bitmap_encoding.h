@@ -0,0 +1,57 @@
+#ifndef LOAD_FONT_BITMAP_ENCODING
+#define LOAD_FONT_BITMAP_ENCODING
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "font.h"
+
+typedef enum {
+    RAW_ENCODING,   // one integer of the column size per column
+    RLE_ENCODING,   // column run length encoding. see bitmap_decoder.h
+    DICT_ENCODING,  // unique columns and index per column
+} BitmapEncoding;
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t* line_offsets;  // offset in data of the first byte of each line
+} RLEBitmap;
+
+typedef struct {
+    union {
+        void* dict;
+        uint8_t* dict8;
+        uint16_t* dict16;
+        uint32_t* dict32;
+        uint64_t* dict64;
+    };
+    size_t dict_len;
+    size_t column_size;
+    uint32_t* indices;  // written as the smallest of uint8_t, uint16_t and uint32_t that addresses dict_len
+    size_t index_size;  // 1, 2 or 4
+} DictBitmap;
+
+bool parse_bitmap_encoding(const char* str, BitmapEncoding* encoding);
+
+// runs don't cross line ends, so that each line can be decoded on its own
+void rle_encode(const RenderedText* text, RLEBitmap* result);
+void free_rle_bitmap(RLEBitmap* bitmap);
+
+void dict_encode(const RenderedText* text, DictBitmap* result);
+// bytes of bitmap_dict and bitmap_indices
+size_t dict_bitmap_size(const DictBitmap* bitmap, size_t bitmap_len);
+void free_dict_bitmap(DictBitmap* bitmap);
+
+// write bitmap arrays of the encoding. line tables are left to the caller
+bool write_encoded_bitmap(FILE* outfile, const RenderedText* text, BitmapEncoding encoding);
+
+// write line_widths and line_ends arrays
+void write_line_tables(FILE* outfile, const RenderedText* text);
+
+// write binary pbm of the bitmap, one column per row
+void write_pbm(FILE* pbmfile, const RenderedText* text);
+
+// print size and decode throughput of every encoding for the text
+void report_bitmap_encodings(FILE* out, const RenderedText* text);
+#endif
@@ -0,0 +1,121 @@
+/*
+ * rle and dict encoders, and the decode loops timed by report_bitmap_encodings, for one column type.
+ * bitmap_encoding.c includes this once per column type with these defined, so there is no include guard:
+ *   COLUMN_T         uint8_t, uint16_t, uint32_t or uint64_t
+ *   COLUMN_FN(name)  name suffixed with the column width
+ */
+
+static void COLUMN_FN(put_column)(RLEBitmap* result, COLUMN_T column) {
+    for (size_t i = 0; i < sizeof(COLUMN_T); i++) {
+        result->data[result->size++] = (column >> (8 * i)) & 0xff;
+    }
+}
+
+static void COLUMN_FN(rle_encode_segment)(const COLUMN_T* columns, size_t len, RLEBitmap* result) {
+    size_t i = 0;
+    while (i < len) {
+        COLUMN_T column = columns[i];
+        size_t max_run = column == 0 ? BITMAP_RLE_MAX_ZEROS : BITMAP_RLE_MAX_REPEAT;
+        size_t run = 1;
+        while (i + run < len && run < max_run && columns[i + run] == column) {
+            run++;
+        }
+        if (column == 0) {
+            result->data[result->size++] = BITMAP_RLE_ZEROS + (run - 1);
+            i += run;
+        } else if (run >= 2) {
+            result->data[result->size++] = BITMAP_RLE_REPEAT + (run - 2);
+            COLUMN_FN(put_column)(result, column);
+            i += run;
+        } else {
+            // literal until a blank column or a repeat starts
+            size_t count = 1;
+            while (i + count < len && count < BITMAP_RLE_MAX_LITERAL && columns[i + count] != 0 &&
+                   not(i + count + 1 < len && columns[i + count + 1] == columns[i + count])) {
+                count++;
+            }
+            result->data[result->size++] = BITMAP_RLE_LITERAL + (count - 1);
+            for (size_t j = 0; j < count; j++) {
+                COLUMN_FN(put_column)(result, columns[i + j]);
+            }
+            i += count;
+        }
+    }
+}
+
+static void COLUMN_FN(rle_encode_lines)(const RenderedText* text, RLEBitmap* result) {
+    const COLUMN_T* bitmap = text->bitmap;
+    size_t begin = 0;
+    for (size_t line = 0; line <= text->linecount; line++) {
+        size_t end = line < text->linecount ? text->line_ends[line] : text->bitmap_len;
+        result->line_offsets[line] = result->size;
+        COLUMN_FN(rle_encode_segment)(bitmap + begin, end - begin, result);
+        begin = end;
+    }
+}
+
+// columns are numbered in order of first appearance
+static void COLUMN_FN(dict_encode)(const RenderedText* text, DictBitmap* result) {
+    const COLUMN_T* bitmap = text->bitmap;
+    // open addressing table of dict indices keyed by column
+    size_t bucket_count = 2;
+    while (bucket_count < text->bitmap_len * 2) {
+        bucket_count *= 2;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * bucket_count);
+    memset(buckets, 0xff, sizeof(uint32_t) * bucket_count);
+    COLUMN_T* dict = malloc(sizeof(COLUMN_T) * (text->bitmap_len + 1));
+    result->dict = dict;
+    result->dict_len = 0;
+    for (size_t i = 0; i < text->bitmap_len; i++) {
+        COLUMN_T column = bitmap[i];
+        size_t bucket = hash_column(column) & (bucket_count - 1);
+        while (buckets[bucket] != UINT32_MAX && dict[buckets[bucket]] != column) {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        if (buckets[bucket] == UINT32_MAX) {
+            buckets[bucket] = result->dict_len;
+            dict[result->dict_len++] = column;
+        }
+        result->indices[i] = buckets[bucket];
+    }
+    free(buckets);
+}
+
+static void COLUMN_FN(decode_rle)(void* context) {
+    DecodeBench* bench = context;
+    COLUMN_T* decoded = bench->decoded;
+    size_t len = bench->text->bitmap_len;
+    COLUMN_FN(BitmapRLEDecoder) decoder;
+    COLUMN_FN(bitmap_rle_init)(&decoder, bench->rle->data, bench->rle->size);
+    size_t count;
+    bench->decoded_len = 0;
+    while ((count = COLUMN_FN(bitmap_rle_decode)(&decoder, decoded + bench->decoded_len,
+                                                 display_chunk(len, bench->decoded_len))) != 0) {
+        bench->decoded_len += count;
+    }
+    if (decoder.cursor != decoder.end || decoder.remaining != 0) {
+        bench->decoded_len++;  // more columns than the bitmap. fails the round trip
+    }
+}
+
+static void COLUMN_FN(decode_dict)(void* context) {
+    DecodeBench* bench = context;
+    const COLUMN_T* dict = bench->dict->dict;
+    COLUMN_T* decoded = bench->decoded;
+    size_t len = bench->text->bitmap_len;
+    for (size_t i = 0; i < len; i += DISPLAY_BUFFER_COLUMNS) {
+        switch (bench->dict->index_size) {
+            case sizeof(uint8_t):
+                COLUMN_FN(bitmap_dict_decode8)(dict, bench->indices8 + i, display_chunk(len, i), decoded + i);
+                break;
+            case sizeof(uint16_t):
+                COLUMN_FN(bitmap_dict_decode16)(dict, bench->indices16 + i, display_chunk(len, i), decoded + i);
+                break;
+            default:
+                COLUMN_FN(bitmap_dict_decode32)(dict, bench->dict->indices + i, display_chunk(len, i), decoded + i);
+                break;
+        }
+    }
+    bench->decoded_len = len;
+}
@@ -0,0 +1,772 @@
+#include "font.h"
+
+#include <iso646.h>
+#include <pthread.h>
+#include <simple_logging.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MIN_VER 2
+#define INDEXED_VER 3
+#define RANGED_VER 4
+
+#define FDIR_ENTRY_SIZE 12  // chunk id, position, size
+
+// chunk and lists on the top level font_open reads. other top level chunks are stepped over unread
+static const char* const top_level_ids[] = {"FTMT", "CMAP", "GLYF"};
+
+// lists nested in CMAP and GLYF whose children font_open reads
+static bool is_font_list(FourCC list_type) { return list_type == FOURCC("SPLI"); }
+
+static bool is_font_chunk(FourCC chunk_id) {
+    static const char* const chunk_ids[] = {"FTMT", "CM1B", "CM2B", "CM3B", "CM4B", "CMRG", "CMHS", "GLMT", "GLSP"};
+    for (size_t i = 0; i < sizeof(chunk_ids) / sizeof(chunk_ids[0]); i++) {
+        if (chunk_id == FOURCC(chunk_ids[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// what font_open allocates for. counted before the font arena is reserved, so that it is sized from them
+typedef struct {
+    size_t chunk_count;
+    size_t glyph_range_count;
+    size_t meta_size;  // bytes of FTMT, which bound the font name
+} FontChunkTally;
+
+static void tally_chunk(FontChunkTally* tally, const RIFFPlainChunkInfo* info) {
+    tally->chunk_count++;
+    if (info->chunk_id == FOURCC("GLSP")) {
+        tally->glyph_range_count++;
+    } else if (info->chunk_id == FOURCC("FTMT") && info->size > tally->meta_size) {
+        tally->meta_size = info->size;
+    }
+}
+
+// append the chunks of a font list and of the font lists in it before the tail sentinel of the chunklist,
+// or only tally them if tail is NULL
+static bool collect_list_chunks(RIFFCursor* cursor, PlainChunkList* tail, Arena* arena, FontChunkTally* tally) {
+    while (riff_cursor_next(cursor)) {
+        if (cursor->chunk.type == LIST && is_font_list(cursor->chunk.info.list.list_type)) {
+            RIFFCursor list = riff_cursor_descend(cursor);
+            if (not collect_list_chunks(&list, tail, arena, tally)) {
+                return false;
+            }
+        } else if (cursor->chunk.type == PLAIN && is_font_chunk(cursor->chunk.info.plain.chunk_id)) {
+            tally_chunk(tally, &cursor->chunk.info.plain);
+            if (tail != NULL) {
+                list_append(tail, &cursor->chunk.info.plain, arena);
+            }
+        }
+    }
+    if (cursor->error) {
+        SIMPLE_LOG(FATAL, "failed to parse chunk header");
+        return false;
+    }
+    return true;
+}
+
+// find each of top_level_ids from the start of the form, so their order doesn't matter, and collect them.
+// a missing one is not an error here. font_open reports the chunk it lacks
+static bool collect_font_chunks(const RIFFCursor* form, PlainChunkList* tail, Arena* arena, FontChunkTally* tally) {
+    for (size_t i = 0; i < sizeof(top_level_ids) / sizeof(top_level_ids[0]); i++) {
+        RIFFCursor cursor = *form;
+        if (not riff_cursor_find(&cursor, FOURCC(top_level_ids[i]))) {
+            if (cursor.error) {
+                SIMPLE_LOG(FATAL, "failed to parse chunk header");
+                return false;
+            }
+            continue;
+        }
+        if (cursor.chunk.type == LIST) {
+            RIFFCursor list = riff_cursor_descend(&cursor);
+            if (not collect_list_chunks(&list, tail, arena, tally)) {
+                return false;
+            }
+        } else {
+            tally_chunk(tally, &cursor.chunk.info.plain);
+            if (tail != NULL) {
+                list_append(tail, &cursor.chunk.info.plain, arena);
+            }
+        }
+    }
+    return true;
+}
+
+// returns pointer to the data of the chunk in the image, or NULL if the chunk exceeds the image
+static const uint8_t* chunk_data(const LoadedFont* font, const RIFFPlainChunkInfo* info) {
+    if (info->pos < 0 || (size_t)info->pos + 8 + info->size > font->image_size) {
+        SIMPLE_LOG(ERROR, "chunk %s at %ld exceeds the end of file", cfourcc(info->chunk_id), info->pos);
+        return NULL;
+    }
+    return font->image + info->pos + 8;
+}
+
+// read chunk header at pos in the image. fails if the chunk exceeds the image
+static bool image_chunk_info(const LoadedFont* font, size_t pos, RIFFPlainChunkInfo* info) {
+    if (pos + 8 > font->image_size) {
+        return false;
+    }
+    memcpy(&info->chunk_id, font->image + pos, sizeof(info->chunk_id));
+    memcpy(&info->size, font->image + pos + 4, sizeof(info->size));
+    info->pos = pos;
+    int padding = info->size % 2 == 0 ? 0 : 1;
+    info->totalsize = info->size + 8 + padding;
+    return pos + 8 + info->size <= font->image_size;
+}
+
+// read entry index of FDIR and the header of the chunk it points to. fails if they don't match
+static bool directory_entry(const LoadedFont* font, size_t index, RIFFPlainChunkInfo* info) {
+    const uint8_t* entry = font->directory + FDIR_ENTRY_SIZE * index;
+    FourCC chunk_id;
+    uint32_t pos;
+    uint32_t size;
+    memcpy(&chunk_id, entry, sizeof(chunk_id));
+    memcpy(&pos, entry + 4, sizeof(pos));
+    memcpy(&size, entry + 8, sizeof(size));
+    return image_chunk_info(font, pos, info) && info->chunk_id == chunk_id && info->size == size;
+}
+
+// version 3 fonts have FDIR right after FTMT, which lists absolute positions of the chunks: cmaps and GLMT first,
+// then every GLSP in gid order. only the entries before the first GLSP are read here, so that opening doesn't take
+// longer with more glyph ranges. font_glyph_range validates a GLSP entry when it reads it
+static bool load_directory(LoadedFont* font, FontChunkTally* tally) {
+    RIFFPlainChunkInfo meta;
+    RIFFPlainChunkInfo dir;
+    uint16_t version;
+    if (not image_chunk_info(font, font->header.pos + 12, &meta) || meta.chunk_id != FOURCC("FTMT") ||
+        meta.size < sizeof(version)) {
+        return false;
+    }
+    memcpy(&version, font->image + meta.pos + 8, sizeof(version));
+    if (version < INDEXED_VER) {
+        return false;
+    }
+    if (not image_chunk_info(font, meta.pos + meta.totalsize, &dir) || dir.chunk_id != FOURCC("FDIR") ||
+        dir.size < sizeof(uint32_t)) {
+        SIMPLE_LOG(WARNING, "FDIR chunk was not found");
+        return false;
+    }
+    uint32_t entry_count;
+    memcpy(&entry_count, font->image + dir.pos + 8, sizeof(entry_count));
+    if (sizeof(uint32_t) + (size_t)entry_count * FDIR_ENTRY_SIZE > dir.size) {
+        SIMPLE_LOG(WARNING, "FDIR chunk is smaller than its entries");
+        return false;
+    }
+    font->directory = font->image + dir.pos + 8 + sizeof(entry_count);
+    size_t glyph_entry_begin = 0;
+    RIFFPlainChunkInfo info;
+    for (; glyph_entry_begin < entry_count; glyph_entry_begin++) {
+        if (not directory_entry(font, glyph_entry_begin, &info)) {
+            SIMPLE_LOG(WARNING, "FDIR entry %zu doesn't match the file", glyph_entry_begin);
+            return false;
+        }
+        if (info.chunk_id == FOURCC("GLSP")) {
+            break;
+        }
+    }
+    font->glyph_entry_begin = glyph_entry_begin;
+    font->glyph_range_count = entry_count - glyph_entry_begin;
+    tally_chunk(tally, &meta);
+    SIMPLE_LOG(DEBUG, "located %u chunks with FDIR", entry_count);
+    return true;
+}
+
+// locate chunk_id in the directory, or in the chunklist if the file was walked. returns false if it's missing
+static bool find_chunk(const LoadedFont* font, FourCC chunk_id, RIFFPlainChunkInfo* info) {
+    if (not font->indexed) {
+        RIFFPlainChunkInfo* found = search_list(font->chunklist, chunk_id);
+        if (found != NULL) {
+            *info = *found;
+        }
+        return found != NULL;
+    }
+    if (chunk_id == FOURCC("FTMT")) {
+        return image_chunk_info(font, font->header.pos + 12, info);  // validated by load_directory
+    }
+    for (size_t i = 0; i < font->glyph_entry_begin; i++) {
+        if (directory_entry(font, i, info) && info->chunk_id == chunk_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool load_cmap(LoadedFont* font, size_t charsize) {
+    CmapTable* table = &font->cmaps[charsize - 1];
+    char cmap_name[5] = {'C', 'M', (char)('0' + charsize), 'B', '\0'};
+    table->chunk_id = FOURCC(cmap_name);
+    table->charsize = charsize;
+    table->itemsize = charsize + 2;
+    RIFFPlainChunkInfo cmap;
+    if (not find_chunk(font, table->chunk_id, &cmap)) {
+        return true;  // reported on lookup, same as a missing table in the file
+    }
+    table->present = true;
+    table->itemcount = cmap.size / table->itemsize;
+    if (cmap.size % table->itemsize != 0) {
+        SIMPLE_LOG(ERROR, "the size of cmap %s (%lu) is not multiple of itemsize (%lu)", cfourcc(cmap.chunk_id),
+                   cmap.size, table->itemsize);
+    }
+    table->items = chunk_data(font, &cmap);
+    if (table->items == NULL) {
+        SIMPLE_LOG(FATAL, "failed to read cmap %s", cfourcc(cmap.chunk_id));
+        return false;
+    }
+    SIMPLE_LOG(DEBUG, "cmap: %s itemcount: %zu", cfourcc(cmap.chunk_id), table->itemcount);
+    return true;
+}
+
+static bool load_cmap_ranges(LoadedFont* font) {
+    CmapRanges* ranges = &font->cmap_ranges;
+    RIFFPlainChunkInfo chunk;
+    if (not find_chunk(font, FOURCC("CMRG"), &chunk) || font->version < RANGED_VER) {
+        return true;  // every item is in CMxB
+    }
+    ranges->ranges = chunk_data(font, &chunk);
+    if (ranges->ranges == NULL || chunk.size % CMAP_RANGE_SIZE != 0) {
+        SIMPLE_LOG(FATAL, "broken CMRG chunk");
+        return false;
+    }
+    ranges->count = chunk.size / CMAP_RANGE_SIZE;
+    SIMPLE_LOG(DEBUG, "cmap ranges: %zu", ranges->count);
+    return true;
+}
+
+static bool load_cmap_hash(LoadedFont* font) {
+    CmapHash* hash = &font->cmap_hash;
+    RIFFPlainChunkInfo chunk;
+    if (not find_chunk(font, FOURCC("CMHS"), &chunk) || font->version < INDEXED_VER) {
+        return true;  // optional
+    }
+    const uint8_t* data = chunk_data(font, &chunk);
+    if (data == NULL || chunk.size < 8) {
+        SIMPLE_LOG(FATAL, "broken CMHS chunk");
+        return false;
+    }
+    memcpy(&hash->bucket_count, data, sizeof(hash->bucket_count));
+    if (hash->bucket_count < 2 || (hash->bucket_count & (hash->bucket_count - 1)) != 0 ||
+        8 + (size_t)hash->bucket_count * CMAP_HASH_BUCKET_SIZE > chunk.size) {
+        SIMPLE_LOG(FATAL, "invalid bucket count %u of CMHS chunk", hash->bucket_count);
+        return false;
+    }
+    hash->shift = 32;
+    for (uint32_t count = hash->bucket_count; count > 1; count >>= 1) {
+        hash->shift--;
+    }
+    hash->buckets = data + 8;
+    hash->present = true;
+    SIMPLE_LOG(DEBUG, "cmap hash buckets: %u", hash->bucket_count);
+    return true;
+}
+
+size_t column_size_for_height(uint16_t height) {
+    if (height == 0 || height > 64) {
+        return 0;
+    }
+    if (height <= 8) {
+        return sizeof(uint8_t);
+    }
+    if (height <= 16) {
+        return sizeof(uint16_t);
+    }
+    if (height <= 32) {
+        return sizeof(uint32_t);
+    }
+    return sizeof(uint64_t);
+}
+
+// read the header of GLSP chunk info. fails if the chunk is smaller than its glyphs
+static bool read_glyph_range(const LoadedFont* font, const RIFFPlainChunkInfo* info, GlyphRange* range) {
+    range->info = *info;
+    const uint8_t* data = chunk_data(font, info);
+    if (data == NULL || info->size < sizeof(uint16_t) * 3) {
+        SIMPLE_LOG(ERROR, "broken GLSP chunk at %ld", info->pos);
+        return false;
+    }
+    memcpy(&range->first_gid, data, sizeof(range->first_gid));
+    memcpy(&range->last_gid, data + 2, sizeof(range->last_gid));
+    memcpy(&range->width, data + 4, sizeof(range->width));
+    range->bitmaps = data + sizeof(uint16_t) * 3;
+    size_t glyph_count = range->last_gid - range->first_gid + 1;
+    if (range->first_gid > range->last_gid ||
+        sizeof(uint16_t) * 3 + font->column_size * range->width * glyph_count > info->size) {
+        SIMPLE_LOG(ERROR, "GLSP chunk at %ld is smaller than its glyphs", info->pos);
+        return false;
+    }
+    return true;
+}
+
+bool font_glyph_range(const LoadedFont* font, size_t index, GlyphRange* range) {
+    if (not font->indexed) {
+        *range = font->glyph_ranges[index];
+        return true;
+    }
+    RIFFPlainChunkInfo info;
+    if (not directory_entry(font, font->glyph_entry_begin + index, &info) || info.chunk_id != FOURCC("GLSP")) {
+        SIMPLE_LOG(ERROR, "FDIR entry of glyph range %zu doesn't match the file", index);
+        return false;
+    }
+    return read_glyph_range(font, &info, range);
+}
+
+// read every GLSP of the chunklist. a font with FDIR reads them on demand instead
+static bool load_glyph_ranges(LoadedFont* font, size_t capacity) {
+    if (font->indexed) {
+        return true;
+    }
+    font->glyph_ranges = arena_alloc(&font->arena, sizeof(GlyphRange) * (capacity + 1));
+    font->glyph_range_count = 0;
+    PlainChunkList* chunklist = font->chunklist;
+    while (chunklist->next != NULL) {
+        if ((not list_is_sentinel(chunklist)) && chunklist->info.chunk_id == FOURCC("GLSP")) {
+            if (not read_glyph_range(font, &chunklist->info, &font->glyph_ranges[font->glyph_range_count])) {
+                return false;
+            }
+            font->glyph_range_count++;
+        }
+        chunklist = chunklist->next;
+    }
+    return true;
+}
+
+// what font_open allocates: the name, and for a walked file the chunklist with its sentinels and the glyph ranges
+static size_t font_arena_size(const LoadedFont* font, const FontChunkTally* tally) {
+    size_t result = arena_size_of(tally->meta_size + 1);
+    if (not font->indexed) {
+        result += arena_size_of(sizeof(PlainChunkList)) * (tally->chunk_count + 2) +
+                  arena_size_of(sizeof(GlyphRange) * (tally->glyph_range_count + 1));
+    }
+    return result;
+}
+
+LoadedFont* font_open(const char* path) {
+    LoadedFont* font = calloc(1, sizeof(LoadedFont));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        SIMPLE_LOG(FATAL, "failed to open font file");
+        goto fail;
+    }
+    struct stat font_stat;
+    if (fstat(fileno(file), &font_stat) == -1 || font_stat.st_size == 0) {
+        SIMPLE_LOG(FATAL, "failed to stat font file");
+        goto fail;
+    }
+    font->image_size = font_stat.st_size;
+    void* image = mmap(NULL, font->image_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (image == MAP_FAILED) {
+        SIMPLE_LOG(FATAL, "failed to map font file");
+        goto fail;
+    }
+    font->image = image;
+
+    font->header = riff_open(file);
+    if (font->header.form_id == FOURCC("NULL")) {
+        SIMPLE_LOG(FATAL, "failed to parse riff header");
+        goto fail;
+    }
+    // without a directory, tally the chunks first, then reserve the arena for exactly those and collect them
+    FontChunkTally tally = {};
+    font->indexed = load_directory(font, &tally);
+    if (not font->indexed) {
+        RIFFCursor form = riff_cursor_open(file, &font->header);
+        if (not collect_font_chunks(&form, NULL, NULL, &tally)) {
+            goto fail;
+        }
+        if (not arena_init(&font->arena, font_arena_size(font, &tally))) {
+            goto fail;
+        }
+        font->chunklist = new_list(&font->arena);
+        FontChunkTally collected = {};
+        // appended before the tail sentinel, which stays the same node, so that appending doesn't walk the list
+        if (not collect_font_chunks(&form, font->chunklist->next, &font->arena, &collected)) {
+            goto fail;
+        }
+    } else if (not arena_init(&font->arena, font_arena_size(font, &tally))) {
+        goto fail;
+    }
+    fclose(file);
+    file = NULL;  // everything below reads from the image
+
+    RIFFPlainChunkInfo meta;
+    const uint8_t* meta_data = find_chunk(font, FOURCC("FTMT"), &meta) ? chunk_data(font, &meta) : NULL;
+    if (meta_data == NULL || meta.size < sizeof(uint16_t) * 2) {
+        SIMPLE_LOG(FATAL, "FTMT chunk was not found");
+        goto fail;
+    }
+    uint16_t namelen;
+    memcpy(&font->version, meta_data, sizeof(font->version));
+    SIMPLE_LOG(INFO, "format version: %d", font->version);
+    if (font->version < MIN_VER) {
+        SIMPLE_LOG(FATAL, "format is older than %d", MIN_VER);
+        goto fail;
+    }
+    memcpy(&namelen, meta_data + 2, sizeof(namelen));
+    if (namelen > meta.size - sizeof(uint16_t) * 2) {
+        SIMPLE_LOG(FATAL, "font name exceeds FTMT chunk");
+        goto fail;
+    }
+    font->name = arena_alloc(&font->arena, sizeof(char) * (namelen + 1));
+    memcpy(font->name, meta_data + 4, namelen);
+    font->name[namelen + 1 - 1] = '\0';  // last index is length-1
+    SIMPLE_LOG(INFO, "font name: %s", font->name);
+
+    RIFFPlainChunkInfo glyph_meta;
+    const uint8_t* glyph_meta_data =
+        find_chunk(font, FOURCC("GLMT"), &glyph_meta) ? chunk_data(font, &glyph_meta) : NULL;
+    if (glyph_meta_data == NULL || glyph_meta.size < sizeof(uint16_t) * 2) {
+        SIMPLE_LOG(FATAL, "GLMT chunk was not found");
+        goto fail;
+    }
+    memcpy(&font->max_width, glyph_meta_data, sizeof(font->max_width));
+    memcpy(&font->height, glyph_meta_data + 2, sizeof(font->height));
+    font->column_size = column_size_for_height(font->height);
+    if (font->column_size == 0) {
+        SIMPLE_LOG(FATAL, "unsupported glyph height %d", font->height);
+        goto fail;
+    }
+    SIMPLE_LOG(INFO, "glyph height: %d, column size: %zu", font->height, font->column_size);
+
+    for (size_t charsize = 1; charsize <= CMAP_TABLE_COUNT; charsize++) {
+        if (not load_cmap(font, charsize)) {
+            goto fail;
+        }
+    }
+    if (not load_cmap_ranges(font)) {
+        goto fail;
+    }
+    if (not load_cmap_hash(font)) {
+        goto fail;
+    }
+    if (not load_glyph_ranges(font, tally.glyph_range_count)) {
+        goto fail;
+    }
+    return font;
+
+fail:
+    if (file) {
+        fclose(file);
+    }
+    font_close(font);
+    return NULL;
+}
+
+void font_close(LoadedFont* font) {
+    if (font == NULL) {
+        return;
+    }
+    if (font->image) {
+        munmap((void*)font->image, font->image_size);
+    }
+    arena_free(&font->arena);
+    free(font);
+}
+
+static uint32_t search_cmap_hash(const CmapHash* hash, char32_t ch) {
+    uint32_t index = (uint32_t)(ch * CMAP_HASH_MULTIPLIER) >> hash->shift;
+    for (uint32_t probe = 0; probe < hash->bucket_count; probe++) {
+        const uint8_t* bucket = hash->buckets + (size_t)index * CMAP_HASH_BUCKET_SIZE;
+        uint32_t codepoint;
+        memcpy(&codepoint, bucket, sizeof(codepoint));
+        if (codepoint == CMAP_HASH_EMPTY) {
+            return FONT_GID_NOT_FOUND;
+        } else if (codepoint == ch) {
+            uint16_t gid;
+            memcpy(&gid, bucket + 4, sizeof(gid));
+            return gid;
+        }
+        index = (index + 1) & (hash->bucket_count - 1);
+    }
+    return FONT_GID_NOT_FOUND;
+}
+
+static uint32_t search_cmap_ranges(const CmapRanges* ranges, char32_t ch) {
+    // last range which begins at or before ch
+    size_t range_min = 0;
+    size_t range_max = ranges->count;  // exclusive
+    while (range_min < range_max) {
+        size_t pivot = range_min + (range_max - range_min) / 2;
+        uint32_t first_codepoint;
+        memcpy(&first_codepoint, ranges->ranges + CMAP_RANGE_SIZE * pivot, sizeof(first_codepoint));
+        if (first_codepoint <= ch) {
+            range_min = pivot + 1;
+        } else {
+            range_max = pivot;
+        }
+    }
+    if (range_min == 0) {
+        return FONT_GID_NOT_FOUND;
+    }
+    const uint8_t* range = ranges->ranges + CMAP_RANGE_SIZE * (range_min - 1);
+    uint32_t first_codepoint;
+    uint32_t last_codepoint;
+    uint16_t first_gid;
+    memcpy(&first_codepoint, range, sizeof(first_codepoint));
+    memcpy(&last_codepoint, range + 4, sizeof(last_codepoint));
+    memcpy(&first_gid, range + 8, sizeof(first_gid));
+    if (ch > last_codepoint) {
+        return FONT_GID_NOT_FOUND;
+    }
+    return first_gid + (ch - first_codepoint);
+}
+
+uint32_t font_search_char(const LoadedFont* font, char32_t ch) {
+    if (font->cmap_hash.present) {
+        return search_cmap_hash(&font->cmap_hash, ch);
+    }
+    uint32_t ranged_gid = search_cmap_ranges(&font->cmap_ranges, ch);
+    if (ranged_gid != FONT_GID_NOT_FOUND) {
+        return ranged_gid;
+    }
+    size_t charsize;
+    if (ch <= 0xff) {
+        charsize = 1;
+    } else if (ch <= 0xff'ff) {
+        charsize = 2;
+    } else if (ch <= 0xff'ff'ff) {
+        charsize = 3;
+    } else {
+        charsize = 4;
+    }
+    const CmapTable* table = &font->cmaps[charsize - 1];
+    if (not table->present) {
+        SIMPLE_LOG(ERROR, "%s chunk not found", cfourcc(table->chunk_id));
+        return FONT_GID_NOT_FOUND;
+    }
+    size_t range_min = 0;
+    size_t range_max = table->itemcount;  // exclusive
+    while (range_min < range_max) {
+        size_t pivot = range_min + (range_max - range_min) / 2;
+        const uint8_t* item = table->items + table->itemsize * pivot;
+        char32_t pivot_ch = 0;
+        memcpy(&pivot_ch, item, table->charsize);
+        SIMPLE_LOG(DEBUG, "pivot: %zu chsize: %zu ch: %04x pivot_ch: %04x, range_min: %zu, range_max: %zu", pivot,
+                   table->charsize, ch, pivot_ch, range_min, range_max);
+        if (pivot_ch == ch) {
+            uint16_t pivot_gid;
+            memcpy(&pivot_gid, item + table->charsize, sizeof(pivot_gid));
+            return pivot_gid;
+        } else if (pivot_ch < ch) {
+            range_min = pivot + 1;
+        } else {
+            range_max = pivot;
+        }
+    }
+    return FONT_GID_NOT_FOUND;
+}
+
+static const uint8_t* range_glyph_bitmap(const LoadedFont* font, const GlyphRange* range, uint16_t gid,
+                                         uint16_t* width) {
+    *width = range->width;
+    return range->bitmaps + font->column_size * range->width * (gid - range->first_gid);
+}
+
+// ranges are written in gid order, so the last one which begins at or before gid is bisected.
+// the linear scan after it still finds the glyph in a font whose ranges are out of order
+const uint8_t* font_glyph_bitmap(const LoadedFont* font, uint16_t gid, uint16_t* width) {
+    GlyphRange range;
+    size_t range_min = 0;
+    size_t range_max = font->glyph_range_count;  // exclusive
+    while (range_min < range_max) {
+        size_t pivot = range_min + (range_max - range_min) / 2;
+        if (not font_glyph_range(font, pivot, &range)) {
+            return NULL;
+        }
+        if (range.first_gid <= gid) {
+            range_min = pivot + 1;
+        } else {
+            range_max = pivot;
+        }
+    }
+    if (range_min != 0 && font_glyph_range(font, range_min - 1, &range) && gid <= range.last_gid) {
+        return range_glyph_bitmap(font, &range, gid, width);
+    }
+    for (size_t i = 0; i < font->glyph_range_count; i++) {
+        if (not font_glyph_range(font, i, &range)) {
+            return NULL;
+        }
+        if (range.first_gid <= gid && gid <= range.last_gid) {
+            return range_glyph_bitmap(font, &range, gid, width);
+        }
+    }
+    return NULL;
+}
+
+#define COLUMN_T uint8_t
+#define COLUMN_FN(name) name##_8
+#include "render_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint16_t
+#define COLUMN_FN(name) name##_16
+#include "render_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint32_t
+#define COLUMN_FN(name) name##_32
+#include "render_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint64_t
+#define COLUMN_FN(name) name##_64
+#include "render_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+
+size_t font_search_glyph(const LoadedFont* font, uint16_t gid, void* bitmap_buf) {
+    switch (font->column_size) {
+        case sizeof(uint8_t):
+            return search_glyph_8(font, gid, bitmap_buf);
+        case sizeof(uint16_t):
+            return search_glyph_16(font, gid, bitmap_buf);
+        case sizeof(uint32_t):
+            return search_glyph_32(font, gid, bitmap_buf);
+        default:
+            return search_glyph_64(font, gid, bitmap_buf);
+    }
+}
+
+static size_t rendered_text_size(const LoadedFont* font, size_t utf32_strlen) {
+    size_t bitmap_maxlen = (font->max_width + 2) * utf32_strlen;  // absolute maximum
+    return arena_size_of(font->column_size * bitmap_maxlen) + 2 * arena_size_of(sizeof(size_t) * utf32_strlen);
+}
+
+static void alloc_rendered_text(const LoadedFont* font, size_t utf32_strlen, Arena* arena, RenderedText* result) {
+    size_t bitmap_maxlen = (font->max_width + 2) * utf32_strlen;  // absolute maximum
+    result->column_size = font->column_size;
+    result->height = font->height;
+    result->bitmap = arena_alloc(arena, font->column_size * bitmap_maxlen);
+    result->bitmap_len = 0;
+    size_t maxlinecount = utf32_strlen;
+    result->line_widths = arena_alloc(arena, sizeof(size_t) * maxlinecount);
+    result->line_ends = arena_alloc(arena, sizeof(size_t) * maxlinecount);
+    result->linecount = 0;
+}
+
+// render [begin, end) after the columns already in result. only lines terminated by '\n' are recorded.
+// the column type is picked here once, so the loop itself works on a fixed type
+static void render_range(const LoadedFont* font, const char32_t* begin, const char32_t* end, RenderedText* result) {
+    switch (font->column_size) {
+        case sizeof(uint8_t):
+            render_range_8(font, begin, end, result);
+            break;
+        case sizeof(uint16_t):
+            render_range_16(font, begin, end, result);
+            break;
+        case sizeof(uint32_t):
+            render_range_32(font, begin, end, result);
+            break;
+        default:
+            render_range_64(font, begin, end, result);
+            break;
+    }
+}
+
+static void finish_lines(RenderedText* result) {
+    if (result->linecount == 0) {
+        result->linecount = 1;
+        result->line_widths[0] = result->bitmap_len;
+        result->line_ends[0] = result->bitmap_len;
+    }
+}
+
+static const char32_t* find_terminator(const char32_t* utf32_chars) {
+    while (*utf32_chars != '\0') {
+        utf32_chars++;
+    }
+    return utf32_chars;
+}
+
+void font_render(const LoadedFont* font, const char32_t* utf32_chars, size_t utf32_strlen, Arena* arena,
+                 RenderedText* result) {
+    alloc_rendered_text(font, utf32_strlen, arena, result);
+    render_range(font, utf32_chars, find_terminator(utf32_chars), result);
+    finish_lines(result);
+}
+
+typedef struct {
+    const LoadedFont* font;
+    const char32_t* begin;
+    const char32_t* end;
+    RenderedText text;
+} RenderJob;
+
+static void* run_render_job(void* arg) {
+    RenderJob* job = arg;
+    render_range(job->font, job->begin, job->end, &job->text);
+    return NULL;
+}
+
+size_t font_render_arena_size(const LoadedFont* font, size_t utf32_strlen, size_t thread_count) {
+    size_t result = rendered_text_size(font, utf32_strlen);
+    if (thread_count > 1) {
+        // each job counts a terminator, and each of its 3 buffers may take ARENA_ALIGNMENT more when rounded up
+        result += rendered_text_size(font, utf32_strlen + thread_count) + 3 * ARENA_ALIGNMENT * thread_count;
+        result += arena_size_of(sizeof(RenderJob) * thread_count) + arena_size_of(sizeof(pthread_t) * thread_count) +
+                  arena_size_of(sizeof(bool) * thread_count);
+    }
+    return result;
+}
+
+void font_render_parallel(const LoadedFont* font, const char32_t* utf32_chars, size_t utf32_strlen,
+                          size_t thread_count, Arena* arena, RenderedText* result) {
+    const char32_t* end = find_terminator(utf32_chars);
+    size_t total = end - utf32_chars;
+    if (thread_count <= 1 || total < thread_count) {
+        font_render(font, utf32_chars, utf32_strlen, arena, result);
+        return;
+    }
+
+    // every job but the last one ends right after '\n', so that each job starts at the beginning of a line.
+    // buffers of jobs are allocated here, since the arena is not thread safe
+    RenderJob* jobs = arena_alloc(arena, sizeof(RenderJob) * thread_count);
+    size_t job_count = 0;
+    const char32_t* begin = utf32_chars;
+    for (size_t i = 1; i <= thread_count && begin != end; i++) {
+        const char32_t* split = i == thread_count ? end : utf32_chars + total * i / thread_count;
+        if (split < begin) {
+            split = begin;
+        }
+        while (split != end && (split == begin || split[-1] != '\n')) {
+            split++;
+        }
+        jobs[job_count] = (RenderJob){.font = font, .begin = begin, .end = split};
+        alloc_rendered_text(font, split - begin + 1, arena, &jobs[job_count].text);
+        job_count++;
+        begin = split;
+    }
+
+    pthread_t* threads = arena_alloc(arena, sizeof(pthread_t) * job_count);
+    bool* started = arena_alloc(arena, sizeof(bool) * job_count);
+    for (size_t i = 1; i < job_count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, run_render_job, &jobs[i]) == 0;
+        if (not started[i]) {
+            SIMPLE_LOG(WARNING, "failed to create render thread. rendering on calling thread");
+            run_render_job(&jobs[i]);
+        }
+    }
+    run_render_job(&jobs[0]);
+    for (size_t i = 1; i < job_count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    // stitch job results together. line ends are shifted by the prefix sum of bitmap lengths
+    alloc_rendered_text(font, utf32_strlen, arena, result);
+    for (size_t i = 0; i < job_count; i++) {
+        const RenderedText* text = &jobs[i].text;
+        memcpy((uint8_t*)result->bitmap + result->column_size * result->bitmap_len, text->bitmap,
+               result->column_size * text->bitmap_len);
+        memcpy(result->line_widths + result->linecount, text->line_widths, sizeof(size_t) * text->linecount);
+        for (size_t line = 0; line < text->linecount; line++) {
+            result->line_ends[result->linecount + line] = result->bitmap_len + text->line_ends[line];
+        }
+        result->bitmap_len += text->bitmap_len;
+        result->linecount += text->linecount;
+    }
+    finish_lines(result);
+}
@@ -0,0 +1,155 @@
+#ifndef LOAD_FONT_FONT
+#define LOAD_FONT_FONT
+#include <riff_reader.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <uchar.h>
+
+#include "arena.h"
+#include "plain_chunk_list.h"
+
+#define CMAP_TABLE_COUNT 4
+
+#define CMAP_HASH_EMPTY 0xFFFF'FFFFu
+#define CMAP_HASH_MULTIPLIER 0x9E37'79B1u
+#define CMAP_HASH_BUCKET_SIZE 8  // codepoint, gid, reserved
+#define CMAP_RANGE_SIZE 12       // first codepoint, last codepoint, first gid, reserved
+
+typedef struct {
+    FourCC chunk_id;  // CM1B..CM4B
+    bool present;     // false if the chunk was not found in the font
+    size_t charsize;  // bytes per codepoint
+    size_t itemsize;  // bytes per item (codepoint + gid)
+    size_t itemcount;
+    const uint8_t* items;  // points into the font image
+} CmapTable;
+
+// CMHS chunk of version 3 fonts. open addressing hash table of every cmap item
+typedef struct {
+    bool present;
+    uint32_t bucket_count;  // power of 2
+    uint32_t shift;         // 32 - log2(bucket_count)
+    const uint8_t* buckets;  // points into the font image
+} CmapHash;
+
+// CMRG chunk of version 4 fonts. runs of consecutive codepoints mapped to consecutive gids, left out of CMxB tables
+typedef struct {
+    size_t count;
+    const uint8_t* ranges;  // sorted by first codepoint. points into the font image
+} CmapRanges;
+
+typedef struct {
+    uint16_t first_gid;
+    uint16_t last_gid;
+    uint16_t width;
+    RIFFPlainChunkInfo info;  // GLSP chunk
+    const uint8_t* bitmaps;   // points into the font image
+} GlyphRange;
+
+/*
+ * the font file is mapped read-only and every lookup reads from the mapping,
+ * so a loaded font can be shared between threads without locking
+ */
+typedef struct {
+    const uint8_t* image;
+    size_t image_size;
+    RIFFHeaderInfo header;
+    PlainChunkList* chunklist;  // chunks found by walking the file. NULL if indexed
+    uint16_t version;
+    char* name;
+    uint16_t max_width;
+    uint16_t height;
+    size_t column_size;  // bytes per glyph column: 1, 2, 4 or 8, the smallest that holds height pixels
+    bool indexed;  // chunks were located with FDIR instead of walking the file
+    const uint8_t* directory;  // FDIR entries if indexed. points into the font image
+    size_t glyph_entry_begin;  // index of the first GLSP entry in directory. the entries after it are GLSP too
+    CmapTable cmaps[CMAP_TABLE_COUNT];
+    CmapRanges cmap_ranges;
+    CmapHash cmap_hash;
+    GlyphRange* glyph_ranges;  // GLSP chunks found by walking the file. NULL if indexed, read with font_glyph_range
+    size_t glyph_range_count;
+    Arena arena;  // chunklist, name and glyph_ranges. reserved for the chunks font_open found, released by font_close
+} LoadedFont;
+
+// columns are column_size bytes wide. pixel at the top of a column is the most significant of height bits
+typedef struct {
+    union {
+        void* bitmap;
+        uint8_t* bitmap8;
+        uint16_t* bitmap16;
+        uint32_t* bitmap32;
+        uint64_t* bitmap64;
+    };
+    size_t column_size;
+    uint16_t height;
+    size_t bitmap_len;
+    size_t* line_widths;
+    size_t* line_ends;
+    size_t linecount;
+} RenderedText;
+
+/**
+ * @brief open FixedHeightFont file and build in-memory indexes of cmaps and glyph shapes
+ *
+ * @param path path to the font file
+ *
+ * @return loaded font, or NULL on failure. release it with font_close
+ */
+LoadedFont* font_open(const char* path);
+void font_close(LoadedFont* font);
+
+// smallest column type holding height pixels, or 0 if no type does
+size_t column_size_for_height(uint16_t height);
+
+// gids are 16 bit, so this is out of their range
+#define FONT_GID_NOT_FOUND UINT32_MAX
+
+// returns gid of the character, or FONT_GID_NOT_FOUND if the character is not in the font
+uint32_t font_search_char(const LoadedFont* font, char32_t ch);
+
+/**
+ * @brief read glyph range index of the font, in file order. an indexed font reads it from the directory on demand
+ *
+ * @return false if the GLSP chunk of the range is broken
+ */
+bool font_glyph_range(const LoadedFont* font, size_t index, GlyphRange* range);
+
+/**
+ * @brief find glyph bitmap of gid in the font image
+ *
+ * @param width set to the number of columns of the glyph
+ *
+ * @return pointer to little endian columns of font->column_size bytes, or NULL if gid is not in the font
+ */
+const uint8_t* font_glyph_bitmap(const LoadedFont* font, uint16_t gid, uint16_t* width);
+
+/**
+ * @brief copy glyph bitmap of gid into bitmap_buf with blank column around it
+ *
+ * @param bitmap_buf must have room for width + 2 columns of font->column_size bytes
+ *
+ * @return number of columns written
+ */
+size_t font_search_glyph(const LoadedFont* font, uint16_t gid, void* bitmap_buf);
+
+// arena bytes font_render_parallel takes at most for utf32_strlen codepoints. font_render takes that of 1 thread
+size_t font_render_arena_size(const LoadedFont* font, size_t utf32_strlen, size_t thread_count);
+
+/**
+ * @brief render NUL terminated utf32 string
+ *
+ * @param utf32_strlen length of utf32_chars including the terminating NUL
+ * @param arena receives buffers of result, which are valid until the arena is reset
+ */
+void font_render(const LoadedFont* font, const char32_t* utf32_chars, size_t utf32_strlen, Arena* arena,
+                 RenderedText* result);
+
+/**
+ * @brief same as font_render, but lines are split into thread_count groups and rendered concurrently
+ *
+ * @note the result is byte-identical to font_render
+ */
+void font_render_parallel(const LoadedFont* font, const char32_t* utf32_chars, size_t utf32_strlen,
+                          size_t thread_count, Arena* arena, RenderedText* result);
+#endif
@@ -0,0 +1,234 @@
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utf8.h"
+
+#define DEFAULT_ITERATIONS 20'000
+#define DEFAULT_SEED 0x5eed
+#define MAX_CASE_LEN 512
+
+void print_help() {
+    printf("fuzz_utf8: compare utf8_transcode_with of every supported kernel against utf8_transcode_reference\n");
+    printf("usage: fuzz_utf8 [options]\n");
+    printf("options: \n");
+    printf("--iterations <n>     number of generated inputs. default: %d\n", DEFAULT_ITERATIONS);
+    printf("--seed <n>           seed of the input generator. default: %d\n", DEFAULT_SEED);
+    printf("-h/--help            show this help\n");
+}
+
+// splitmix64. the same seed always generates the same inputs, so a failure can be replayed
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+static size_t random_below(uint64_t* state, size_t bound) { return next_random(state) % bound; }
+
+// bytes at the edges of the utf8 classes, which validation has to tell apart
+static const uint8_t interesting_bytes[] = {0x00, 0x7f, 0x80, 0x9f, 0xa0, 0xbf, 0xc0, 0xc1, 0xc2,
+                                            0xdf, 0xe0, 0xed, 0xef, 0xf0, 0xf4, 0xf5, 0xf8, 0xff};
+
+static size_t put_codepoint(char32_t codepoint, uint8_t* out) {
+    if (codepoint < 0x80) {
+        out[0] = codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        out[0] = 0xc0 | (codepoint >> 6);
+        out[1] = 0x80 | (codepoint & 0x3f);
+        return 2;
+    } else if (codepoint < 0x10000) {
+        out[0] = 0xe0 | (codepoint >> 12);
+        out[1] = 0x80 | ((codepoint >> 6) & 0x3f);
+        out[2] = 0x80 | (codepoint & 0x3f);
+        return 3;
+    } else {
+        out[0] = 0xf0 | (codepoint >> 18);
+        out[1] = 0x80 | ((codepoint >> 12) & 0x3f);
+        out[2] = 0x80 | ((codepoint >> 6) & 0x3f);
+        out[3] = 0x80 | (codepoint & 0x3f);
+        return 4;
+    }
+}
+
+// valid codepoint of the given encoded length, near the edges of its range a quarter of the time
+static char32_t random_codepoint(uint64_t* state, size_t length) {
+    static const char32_t first[] = {0, 0x00, 0x80, 0x800, 0x10000};
+    static const char32_t last[] = {0, 0x7f, 0x7ff, 0xffff, 0x10ffff};
+    char32_t codepoint;
+    if (random_below(state, 4) == 0) {
+        codepoint = random_below(state, 2) == 0 ? first[length] + random_below(state, 4)
+                                                : last[length] - random_below(state, 4);
+    } else {
+        codepoint = first[length] + random_below(state, last[length] - first[length] + 1);
+    }
+    if (codepoint >= 0xd800 && codepoint <= 0xdfff) {
+        codepoint = random_below(state, 2) == 0 ? 0xd7ff : 0xe000;
+    }
+    return codepoint;
+}
+
+// valid utf8 in runs of one sequence length, so the vector paths of the kernels see whole blocks
+static size_t generate_valid(uint64_t* state, uint8_t* out, size_t capacity) {
+    size_t len = 0;
+    while (true) {
+        size_t length = 1 + random_below(state, 4);
+        size_t run = 1 + random_below(state, 40);
+        for (size_t i = 0; i < run; i++) {
+            if (len + 4 > capacity) {
+                return len;
+            }
+            len += put_codepoint(random_codepoint(state, length), out + len);
+        }
+        if (random_below(state, 8) == 0) {
+            return len;
+        }
+    }
+}
+
+// flip, overwrite, insert, delete or truncate a few bytes
+static size_t mutate(uint64_t* state, uint8_t* buf, size_t len, size_t capacity) {
+    size_t mutations = 1 + random_below(state, 4);
+    for (size_t m = 0; m < mutations && len > 0; m++) {
+        size_t pos = random_below(state, len);
+        uint8_t byte = interesting_bytes[random_below(state, sizeof(interesting_bytes))];
+        switch (random_below(state, 5)) {
+            case 0:
+                buf[pos] ^= 1 << random_below(state, 8);
+                break;
+            case 1:
+                buf[pos] = byte;
+                break;
+            case 2:
+                if (len < capacity) {
+                    memmove(buf + pos + 1, buf + pos, len - pos);
+                    buf[pos] = byte;
+                    len++;
+                }
+                break;
+            case 3:
+                memmove(buf + pos, buf + pos + 1, len - pos - 1);
+                len--;
+                break;
+            default:
+                len = pos;
+                break;
+        }
+    }
+    return len;
+}
+
+// random bytes, mostly from the interesting ones and the multibyte range
+static size_t generate_random(uint64_t* state, uint8_t* out, size_t capacity) {
+    size_t len = random_below(state, capacity + 1);
+    for (size_t i = 0; i < len; i++) {
+        switch (random_below(state, 3)) {
+            case 0:
+                out[i] = interesting_bytes[random_below(state, sizeof(interesting_bytes))];
+                break;
+            case 1:
+                out[i] = 0x80 + random_below(state, 0x80);
+                break;
+            default:
+                out[i] = random_below(state, 0x100);
+                break;
+        }
+    }
+    return len;
+}
+
+static void print_case(const uint8_t* bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        fprintf(stderr, "%02x%s", bytes[i], i + 1 < len ? " " : "\n");
+    }
+}
+
+// returns false and prints the input if a kernel disagrees with the reference. valid_input is set to its result
+static bool check_case(const uint8_t* bytes, size_t len, bool* valid_input) {
+    // exactly len + 1 bytes, so that sanitizers catch kernels reading past len. the reference needs the NUL
+    char* src = malloc(len + 1);
+    memcpy(src, bytes, len);
+    src[len] = '\0';
+    char32_t* expected = malloc(sizeof(char32_t) * (len + 1));
+    char32_t* actual = malloc(sizeof(char32_t) * (len + 1));
+    size_t expected_written;
+    size_t expected_error = SIZE_MAX;
+    bool expected_valid = utf8_transcode_reference(src, len, expected, &expected_written, &expected_error);
+    *valid_input = expected_valid;
+    bool agrees = true;
+    for (UTF8Kernel kernel = UTF8_SCALAR_KERNEL; kernel < UTF8_KERNEL_COUNT; kernel++) {
+        if (not utf8_kernel_supported(kernel)) {
+            continue;
+        }
+        size_t written;
+        size_t error_offset = SIZE_MAX;
+        bool valid = utf8_transcode_with(kernel, src, len, actual, &written, &error_offset);
+        if (valid != expected_valid || written != expected_written || error_offset != expected_error ||
+            memcmp(actual, expected, sizeof(char32_t) * written) != 0) {
+            fprintf(stderr,
+                    "%s: valid %d, written %zu, error offset %zu. reference: valid %d, written %zu, "
+                    "error offset %zu. input of %zu bytes:\n",
+                    utf8_kernel_name(kernel), valid, written, error_offset, expected_valid, expected_written,
+                    expected_error, len);
+            print_case(bytes, len);
+            agrees = false;
+        }
+    }
+    free(src);
+    free(expected);
+    free(actual);
+    return agrees;
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = DEFAULT_ITERATIONS;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help();
+            return 0;
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else {
+            SIMPLE_LOG(FATAL, "unknown option %s", argv[i]);
+            return 1;
+        }
+    }
+    // the reference logs every invalid sequence it rejects
+    set_log_level(FATAL + 1);
+
+    uint64_t state = seed;
+    uint8_t buf[MAX_CASE_LEN];
+    size_t valid_cases = 0;
+    size_t failures = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        size_t len;
+        switch (i % 3) {
+            case 0:
+                len = generate_valid(&state, buf, sizeof(buf));
+                break;
+            case 1:
+                len = generate_valid(&state, buf, sizeof(buf));
+                len = mutate(&state, buf, len, sizeof(buf));
+                break;
+            default:
+                len = generate_random(&state, buf, 64);
+                break;
+        }
+        bool valid;
+        if (not check_case(buf, len, &valid)) {
+            failures++;
+        }
+        valid_cases += valid;
+    }
+    printf("%zu inputs (%zu valid), seed %#llx: %zu disagree with the reference\n", iterations, valid_cases,
+           (unsigned long long)seed, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -1,10 +1,21 @@
 #include "simple_logging.h"
 
+#include <iso646.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
-static LogLevel current_level = DEFAULT_LOG_LEVEL;
+
+#define LOG_LINE_MAX 512
+#define LOG_RING_CAPACITY 4096  // power of 2
+#define LOG_DRAIN_INTERVAL_NS 1000000
+
+LogLevel simple_log_level = DEFAULT_LOG_LEVEL;
 
 #define STR_LOG_CASE(lvl) \
     case lvl:             \
@@ -18,22 +29,46 @@ const char *stringify_level(LogLevel level) {
         STR_LOG_CASE(ERROR)
         STR_LOG_CASE(FATAL)
     }
+    return "UNKNOWN";
 }
 
-void set_log_level(LogLevel level) { current_level = level; }
+void set_log_level(LogLevel level) { simple_log_level = level; }
 
-void simple_log_impl(LogLevel level, const char *file, int line, const char *func, const char *format, ...) {
-    if (level < current_level) {
-        return;
+/*
+ * bounded multi producer ring. a slot is free for the producer of position pos when its sequence is pos,
+ * and holds a line for the consumer when its sequence is pos + 1
+ */
+typedef struct {
+    atomic_size_t sequence;
+    size_t len;
+    char line[LOG_LINE_MAX];
+} LogSlot;
+
+static LogSlot ring[LOG_RING_CAPACITY];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos;  // only touched by the drain thread
+static atomic_bool async_enabled;
+// producers between their check of async_enabled and the end of their enqueue. stop waits for them to leave
+static atomic_size_t active_producers;
+static atomic_bool stop_requested;
+static pthread_t drain_thread;
+
+// the formatted time only changes once a second, so it's kept per thread
+static _Thread_local time_t cached_second = -1;
+static _Thread_local char cached_time[32];
+
+static const char *format_time(void) {
+    time_t now = time(NULL);
+    if (now != cached_second) {
+        struct tm tm;
+        localtime_r(&now, &tm);
+        strftime(cached_time, sizeof(cached_time), "%Y/%m/%d %H:%M:%S", &tm);
+        cached_second = now;
     }
-    va_list ap;
-    va_start(ap, format);
-    time_t now;
-    time(&now);
-    struct tm *p = localtime(&now);
-    char timebuf[256];
-    strftime(timebuf, sizeof(timebuf), "%Y/%m/%d %H:%M:%S", p);
+    return cached_time;
+}
 
+static const char *basename_of(const char *file) {
     const char *fname = file;
     while (*file != '\0') {
         if (*file == '/') {
@@ -41,10 +76,143 @@ void simple_log_impl(LogLevel level, const char *file, int line, const char *fun
         }
         file++;
     }
+    return fname;
+}
+
+// snprintf returns the length it wanted to write. clamp it to what fits in capacity
+static size_t clamp_written(int written, size_t capacity, bool *truncated) {
+    if (written < 0) {
+        return 0;
+    }
+    if ((size_t)written >= capacity) {
+        *truncated = true;
+        return capacity - 1;
+    }
+    return written;
+}
+
+// format whole line into buf, so that it is written with one call. returns its length without NUL
+static size_t format_line(char *buf, LogLevel level, const char *file, int line, const char *func, const char *format,
+                          va_list ap) {
+    size_t capacity = LOG_LINE_MAX - 1;  // room for the newline
+    bool truncated = false;
+    size_t len = clamp_written(snprintf(buf, capacity, "%s %s:%d %s [%s]: ", format_time(), basename_of(file), line,
+                                        func, stringify_level(level)),
+                               capacity, &truncated);
+    len += clamp_written(vsnprintf(buf + len, capacity - len, format, ap), capacity - len, &truncated);
+    if (truncated) {
+        memcpy(buf + len - 3, "...", 3);
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+static bool enqueue_line(LogLevel level, const char *file, int line, const char *func, const char *format,
+                         va_list ap) {
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    LogSlot *slot;
+    while (true) {
+        slot = &ring[pos & (LOG_RING_CAPACITY - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // full. ap is left untouched for a retry
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+    slot->len = format_line(slot->line, level, file, line, func, format, ap);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+// write every line ready in the ring. returns number of lines written
+static size_t drain_ring(void) {
+    size_t count = 0;
+    while (true) {
+        LogSlot *slot = &ring[dequeue_pos & (LOG_RING_CAPACITY - 1)];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != dequeue_pos + 1) {
+            break;
+        }
+        fwrite(slot->line, 1, slot->len, stderr);
+        atomic_store_explicit(&slot->sequence, dequeue_pos + LOG_RING_CAPACITY, memory_order_release);
+        dequeue_pos++;
+        count++;
+    }
+    return count;
+}
+
+static void *drain_main(void *arg) {
+    (void)arg;
+    while (not atomic_load_explicit(&stop_requested, memory_order_acquire)) {
+        if (drain_ring() == 0) {
+            nanosleep(&(struct timespec){.tv_nsec = LOG_DRAIN_INTERVAL_NS}, NULL);
+        }
+    }
+    drain_ring();
+    return NULL;
+}
+
+bool simple_log_start_async(void) {
+    static bool exit_handler_registered = false;
+    if (atomic_load(&async_enabled)) {
+        return true;
+    }
+    for (size_t i = 0; i < LOG_RING_CAPACITY; i++) {
+        atomic_init(&ring[i].sequence, i);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    atomic_store(&stop_requested, false);
+    if (pthread_create(&drain_thread, NULL, drain_main, NULL) != 0) {
+        return false;
+    }
+    if (not exit_handler_registered) {
+        atexit(simple_log_stop_async);
+        exit_handler_registered = true;
+    }
+    atomic_store(&async_enabled, true);
+    return true;
+}
+
+void simple_log_stop_async(void) {
+    if (not atomic_exchange(&async_enabled, false)) {
+        return;
+    }
+    // a producer that saw async_enabled still enqueues. the drain thread keeps running until it is done,
+    // so its line is written by the final drain, and a full ring keeps being emptied under it
+    while (atomic_load(&active_producers) != 0) {
+        sched_yield();
+    }
+    atomic_store_explicit(&stop_requested, true, memory_order_release);
+    pthread_join(drain_thread, NULL);
+}
 
-    fprintf(stderr, "%s %s:%d %s [%s]: ", timebuf, fname, line, func, stringify_level(level));
-    vfprintf(stderr, format, ap);
-    fprintf(stderr, "\n");
+void simple_log_impl(LogLevel level, const char *file, int line, const char *func, const char *format, ...) {
+    if (level < simple_log_level) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, format);
+    // registered before async_enabled is read, both sequentially consistent, so that either this sees
+    // stop clear async_enabled or stop sees this producer and waits for it
+    atomic_fetch_add(&active_producers, 1);
+    if (atomic_load(&async_enabled)) {
+        while (not enqueue_line(level, file, line, func, format, ap)) {
+            sched_yield();  // full. wait for the drain thread rather than lose the line
+        }
+        atomic_fetch_sub(&active_producers, 1);
+    } else {
+        atomic_fetch_sub(&active_producers, 1);
+        char buf[LOG_LINE_MAX];
+        size_t len = format_line(buf, level, file, line, func, format, ap);
+        fwrite(buf, 1, len, stderr);
+    }
     va_end(ap);
 }
 #define PARSE_LOG_CASE(str, level)          \
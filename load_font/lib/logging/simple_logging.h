@@ -11,9 +11,39 @@ typedef enum {
 
 #define DEFAULT_LOG_LEVEL ERROR
 
+// calls below this level are compiled out, arguments included. e.g. -DSIMPLE_LOG_MIN_LEVEL=WARNING
+#ifndef SIMPLE_LOG_MIN_LEVEL
+#define SIMPLE_LOG_MIN_LEVEL DEBUG
+#endif
+
+// runtime level. read by SIMPLE_LOG before it evaluates the arguments. change it with set_log_level
+extern LogLevel simple_log_level;
+
 void set_log_level(LogLevel level);
 void simple_log_impl(LogLevel level, const char* file, int line, const char* func, const char* format, ...);
 LogLevel parse_log_level(const char* str);
 
-#define SIMPLE_LOG(level, format, ...) simple_log_impl(level, __FILE__, __LINE__, __func__, format, ##__VA_ARGS__)
+/**
+ * @brief write log lines from a background thread from now on.
+ * SIMPLE_LOG only formats the line into a lock-free ring buffer, so logging threads don't wait on stderr
+ * unless the buffer is full
+ *
+ * @return false if the thread could not be started. logging stays synchronous then
+ */
+bool simple_log_start_async(void);
+// drain the buffer and go back to synchronous logging. registered with atexit by simple_log_start_async
+void simple_log_stop_async(void);
+
+#ifdef __FILE_NAME__
+#define SIMPLE_LOG_FILE __FILE_NAME__
+#else
+#define SIMPLE_LOG_FILE __FILE__
+#endif
+
+#define SIMPLE_LOG(level, format, ...)                                                          \
+    do {                                                                                        \
+        if ((level) >= SIMPLE_LOG_MIN_LEVEL && (level) >= simple_log_level) {                   \
+            simple_log_impl(level, SIMPLE_LOG_FILE, __LINE__, __func__, format, ##__VA_ARGS__); \
+        }                                                                                       \
+    } while (false)
 #endif
@@ -13,10 +13,10 @@ size_t stringize_fourcc(FourCC fourcc, char* dst, size_t len) {
     dst[4] = '\0';
     return 5;
 }
-const char* cfourcc(FourCC fourcc) {
-    static char result[5] = {0};
-    memcpy(result, &fourcc, 4);
-    return result;
+const char* cfourcc_r(FourCC fourcc, char* dst) {
+    memcpy(dst, &fourcc, 4);
+    dst[4] = '\0';
+    return dst;
 }
 RIFFHeaderInfo riff_open(FILE* file) {
     FourCC riff;
@@ -71,3 +71,41 @@ void riff_rewind_chunk(FILE* file, const RIFFPlainChunkInfo* info) { fseek(file,
 void riff_seek_in_chunk(FILE* file, const RIFFPlainChunkInfo* info, long offset) {
     fseek(file, info->pos + 8 + offset, SEEK_SET);
 }
+
+RIFFCursor riff_cursor_open(FILE* file, const RIFFHeaderInfo* header) {
+    return (RIFFCursor){.file = file, .next = header->pos + 12, .end = header->pos + 8 + header->size};
+}
+RIFFCursor riff_cursor_descend(const RIFFCursor* cursor) {
+    const RIFFPlainChunkInfo* list = &cursor->chunk.info.list.plain_info;
+    return (RIFFCursor){.file = cursor->file, .next = list->pos + 12, .end = list->pos + 8 + list->size};
+}
+bool riff_cursor_next(RIFFCursor* cursor) {
+    if (cursor->error || cursor->next + 8 > cursor->end) {
+        return false;
+    }
+    if (fseek(cursor->file, cursor->next, SEEK_SET) != 0) {
+        SIMPLE_LOG(ERROR, "failed to seek to chunk at %ld", cursor->next);
+        cursor->error = true;
+        return false;
+    }
+    RIFFChunkInfo chunk = riff_read_chunk_info(cursor->file);
+    RIFFPlainChunkInfo info = PLAININFO(chunk);
+    if (info.chunk_id == FOURCC("NULL") || (chunk.type == LIST && info.size < 4) ||
+        info.pos + 8 + (long)info.size > cursor->end) {
+        SIMPLE_LOG(ERROR, "chunk %s at %ld exceeds its list", cfourcc(info.chunk_id), info.pos);
+        cursor->error = true;
+        return false;
+    }
+    cursor->chunk = chunk;
+    cursor->next = info.pos + info.totalsize;
+    return true;
+}
+bool riff_cursor_find(RIFFCursor* cursor, FourCC id) {
+    while (riff_cursor_next(cursor)) {
+        const RIFFChunkInfo* chunk = &cursor->chunk;
+        if (chunk->type == LIST ? chunk->info.list.list_type == id : chunk->info.plain.chunk_id == id) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -8,7 +8,10 @@ typedef uint32_t FourCC;
 #define FOURCC(str) (((str)[3] << 24) | ((str)[2] << 16) | ((str)[1] << 8) | ((str)[0]))
 
 size_t stringize_fourcc(FourCC fourcc, char* dst, size_t len);
-const char* cfourcc(FourCC fourcc);
+// writes NUL terminated fourcc into dst, which must have room for 5 chars, and returns dst
+const char* cfourcc_r(FourCC fourcc, char* dst);
+// the buffer is a compound literal, so the result is valid until the end of the enclosing block
+#define cfourcc(fourcc) cfourcc_r((fourcc), (char[5]){0})
 
 typedef struct {
     FourCC form_id;      // RIFF format id
@@ -62,4 +65,31 @@ void riff_skip_chunk(FILE* file, const RIFFPlainChunkInfo* info);
 void riff_rewind_chunk(FILE* file, const RIFFPlainChunkInfo* info);
 void riff_seek_in_chunk(FILE* file, const RIFFPlainChunkInfo* info, long offset);  // SEEK_SET only
 
+/*
+ * cursor over the chunks of the RIFF form or of one LIST. a chunk header is read when the cursor steps onto it,
+ * and a LIST is entered only by riff_cursor_descend, so stepping over a LIST skips its whole subtree in one seek
+ */
+typedef struct {
+    FILE* file;
+    long next;            // position of the next chunk header
+    long end;             // end of the data of the form or LIST
+    RIFFChunkInfo chunk;  // the chunk the cursor is on. valid after riff_cursor_next returned true
+    bool error;           // a chunk header was unreadable or exceeded the end
+} RIFFCursor;
+
+// cursor before the first chunk of the form. header is the result of riff_open
+RIFFCursor riff_cursor_open(FILE* file, const RIFFHeaderInfo* header);
+// cursor before the first chunk of the LIST the cursor is on
+RIFFCursor riff_cursor_descend(const RIFFCursor* cursor);
+/**
+ * @brief step onto the next chunk
+ *
+ * @return false at the end of the form or LIST, or if the chunk is broken, which sets error
+ *
+ * @note the file position is unspecified after the call. seek to the chunk before reading its data
+ */
+bool riff_cursor_next(RIFFCursor* cursor);
+// step onto the next chunk whose id is id, or LIST whose list type is id. returns false if there is none
+bool riff_cursor_find(RIFFCursor* cursor, FourCC id);
+
 #endif
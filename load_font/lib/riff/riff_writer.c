@@ -0,0 +1,123 @@
+#include "riff_writer.h"
+
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdio.h>
+
+static bool write_or_fail(RIFFWriter* writer, const void* data, size_t len) {
+    if (writer->error) {
+        return false;
+    }
+    if (len != 0 && fwrite(data, 1, len, writer->file) != len) {
+        SIMPLE_LOG(ERROR, "failed to write %zu bytes", len);
+        writer->error = true;
+        return false;
+    }
+    return true;
+}
+
+static bool write_header(RIFFWriter* writer, FourCC chunk_id) {
+    if (writer->error) {
+        return false;
+    }
+    if (writer->depth == RIFF_WRITER_MAX_DEPTH) {
+        SIMPLE_LOG(ERROR, "chunks are nested deeper than %d", RIFF_WRITER_MAX_DEPTH);
+        writer->error = true;
+        return false;
+    }
+    long pos = ftell(writer->file);
+    uint32_t size = 0;  // backpatched by riff_end_chunk
+    if (not write_or_fail(writer, &chunk_id, sizeof(chunk_id)) || not write_or_fail(writer, &size, sizeof(size))) {
+        return false;
+    }
+    writer->open_chunks[writer->depth] = pos;
+    writer->open_chunk_ids[writer->depth] = chunk_id;
+    writer->depth++;
+    return true;
+}
+
+RIFFWriter riff_writer_begin(FILE* file, FourCC form_id) {
+    RIFFWriter result = {.file = file};
+    if (write_header(&result, FOURCC("RIFF"))) {
+        write_or_fail(&result, &form_id, sizeof(form_id));
+    }
+    return result;
+}
+
+bool riff_writer_end(RIFFWriter* writer) {
+    while (writer->depth > 0) {
+        if (not riff_end_chunk(writer, NULL)) {
+            return false;
+        }
+    }
+    if (fflush(writer->file) != 0) {
+        SIMPLE_LOG(ERROR, "failed to flush riff file");
+        writer->error = true;
+    }
+    return not writer->error;
+}
+
+bool riff_begin_chunk(RIFFWriter* writer, FourCC chunk_id) { return write_header(writer, chunk_id); }
+
+bool riff_begin_list(RIFFWriter* writer, FourCC list_type) {
+    return write_header(writer, FOURCC("LIST")) && write_or_fail(writer, &list_type, sizeof(list_type));
+}
+
+bool riff_write(RIFFWriter* writer, const void* data, size_t len) { return write_or_fail(writer, data, len); }
+
+bool riff_end_chunk(RIFFWriter* writer, RIFFPlainChunkInfo* info) {
+    if (writer->error) {
+        return false;
+    }
+    if (writer->depth == 0) {
+        SIMPLE_LOG(ERROR, "no chunk to end");
+        writer->error = true;
+        return false;
+    }
+    writer->depth--;
+    long pos = writer->open_chunks[writer->depth];
+    long end = ftell(writer->file);
+    long size = end - pos - 8;
+    if (size > UINT32_MAX) {
+        SIMPLE_LOG(ERROR, "chunk at %ld is larger than 4GiB", pos);
+        writer->error = true;
+        return false;
+    }
+    uint32_t size32 = size;
+    if (not riff_patch(writer, pos + 4, &size32, sizeof(size32))) {
+        return false;
+    }
+    uint8_t padding = 0;
+    if (size32 % 2 == 1 && not write_or_fail(writer, &padding, 1)) {
+        return false;
+    }
+    if (info != NULL) {
+        *info = (RIFFPlainChunkInfo){writer->open_chunk_ids[writer->depth], size32, pos, size32 + 8 + size32 % 2};
+    }
+    return true;
+}
+
+bool riff_write_chunk(RIFFWriter* writer, FourCC chunk_id, const void* data, size_t len, RIFFPlainChunkInfo* info) {
+    return riff_begin_chunk(writer, chunk_id) && riff_write(writer, data, len) && riff_end_chunk(writer, info);
+}
+
+bool riff_patch(RIFFWriter* writer, long pos, const void* data, size_t len) {
+    if (writer->error) {
+        return false;
+    }
+    long end = ftell(writer->file);
+    if (pos < 0 || pos + (long)len > end) {
+        SIMPLE_LOG(ERROR, "patch of %zu bytes at %ld is beyond the written data", len, pos);
+        writer->error = true;
+        return false;
+    }
+    if (fseek(writer->file, pos, SEEK_SET) != 0 || not write_or_fail(writer, data, len) ||
+        fseek(writer->file, end, SEEK_SET) != 0) {
+        SIMPLE_LOG(ERROR, "failed to patch riff file at %ld", pos);
+        writer->error = true;
+        return false;
+    }
+    return true;
+}
+
+long riff_writer_tell(const RIFFWriter* writer) { return ftell(writer->file); }
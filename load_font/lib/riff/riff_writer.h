@@ -0,0 +1,51 @@
+#ifndef LIB_RIFF_RIFF_WRITER
+#define LIB_RIFF_RIFF_WRITER
+#include <stdint.h>
+#include <stdio.h>
+
+#include "riff_reader.h"
+
+#define RIFF_WRITER_MAX_DEPTH 16
+
+/**
+ * streaming riff writer. chunk headers are written with size 0 when a chunk begins, and the size is
+ * backpatched when it ends, so data goes straight to the file without being assembled in memory.
+ * the file must be seekable.
+ *
+ * every function returns false once any write has failed, and keeps doing so
+ */
+typedef struct {
+    FILE* file;
+    long open_chunks[RIFF_WRITER_MAX_DEPTH];  // positions of headers of chunks not ended yet, RIFF header first
+    FourCC open_chunk_ids[RIFF_WRITER_MAX_DEPTH];  // for the info riff_end_chunk returns
+    size_t depth;
+    bool error;
+} RIFFWriter;
+
+/**
+ * @brief write riff header and start its data
+ *
+ * @param file output file. cursor must be where the riff header goes.
+ * @param form_id RIFF format id
+ */
+RIFFWriter riff_writer_begin(FILE* file, FourCC form_id);
+// end every open chunk and the riff header. doesn't close the file
+bool riff_writer_end(RIFFWriter* writer);
+
+bool riff_begin_chunk(RIFFWriter* writer, FourCC chunk_id);
+bool riff_begin_list(RIFFWriter* writer, FourCC list_type);
+bool riff_write(RIFFWriter* writer, const void* data, size_t len);
+/**
+ * @brief backpatch size of the innermost open chunk and pad it to even length
+ *
+ * @param info if not NULL, receives position and size of the chunk, e.g. for a directory of chunks
+ */
+bool riff_end_chunk(RIFFWriter* writer, RIFFPlainChunkInfo* info);
+// begin, write and end a chunk at once
+bool riff_write_chunk(RIFFWriter* writer, FourCC chunk_id, const void* data, size_t len, RIFFPlainChunkInfo* info);
+// overwrite len bytes at absolute position pos, which must have been written already. the cursor stays at the end
+bool riff_patch(RIFFWriter* writer, long pos, const void* data, size_t len);
+// absolute position where the next byte goes
+long riff_writer_tell(const RIFFWriter* writer);
+
+#endif
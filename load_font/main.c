@@ -9,10 +9,14 @@
 #include <sys/stat.h>
 #include <uchar.h>
 
-#include "plain_chunk_list.h"
+#include "bitmap_encoding.h"
+#include "font.h"
+#include "server.h"
+#include "subset.h"
+#include "utf8.h"
 #define INDENT "  "
 
-void visit_riff_list(FILE* file, uint32_t total, int indent, PlainChunkList* chunklist);
+void visit_riff_list(RIFFCursor* cursor, size_t depth, size_t max_depth);
 
 void print_help() {
     printf("load_font: load FixedHeightFont file and extract bitmap for specified characters\n");
@@ -20,28 +24,34 @@ void print_help() {
     printf("options: \n");
     printf("--log-level <level>  set log level to <level>\n");
     printf("                     <level> can be: DEBUG, INFO, WARNING, ERROR, FATAL\n");
+    printf("--async-log          write log from a background thread, so logging doesn't stall rendering\n");
     printf("--riff-view          show riff information only and don't extract font\n");
+    printf("--riff-depth <n>     with --riff-view, show lists nested up to <n> levels. deeper ones are skipped\n");
     printf("-o/--output <file>   output file path. required\n");
     printf("-c/--chars  <str>    string of characters to be converted into bitmap\n");
     printf("-C/--charfile <file> path to a file containing string to be converted\n");
     printf("--pbm-output <file>  pbm output file path. optional\n");
+    printf("--encoding <enc>     encoding of bitmap in output. <enc> can be: raw, rle, dict. default: raw\n");
+    printf("--encoding-stats     print size and decode speed of every encoding to stderr\n");
+    printf("--utf8-stats         print utf8 transcoding speed of every kernel for -c/-C to stderr\n");
+    printf("--subset-header <file> write C header with only the glyphs used in -c/-C and a renderer\n");
+    printf("-j/--threads <n>     render lines on <n> threads. default: 1\n");
+    printf("--serve              keep font loaded and serve render requests on stdin/stdout\n");
+    printf("--socket <path>      same as --serve, but serve on unix domain socket <path>\n");
+    printf("--stats              print latency and throughput of --serve/--socket to stderr\n");
+    printf("--memory-stats       print peak and reserved bytes of the font and render arenas to stderr\n");
     printf("-h/--help            show this help\n");
 }
 
 typedef enum {
     LOAD_FONT_MODE,
     RIFF_VIEW_MODE,
+    SERVE_MODE,
+    SUBSET_MODE,
 } AppMode;
 
 AppMode mode = LOAD_FONT_MODE;
 
-char32_t cstr_to_codepoint_utf8(const char* cstr, size_t* n_used_cstr);
-char32_t cstr_to_codepoint_native(const char* cstr, size_t* n_used_cstr);
-
-uint32_t search_char(FILE* file, PlainChunkList* chunklist, char32_t ch);
-
-size_t search_glyph(FILE* file, PlainChunkList* glyphlist, uint16_t gid, uint16_t* bitmap_buf);
-
 bool is_option(const char* arg) {
     size_t len = strlen(arg);
     if (len < 2 || arg[0] != '-') {
@@ -67,12 +77,27 @@ bool match_arg(const char* arg, char short_name, const char* long_name) {
 int main(int argc, const char** argv) {
     int exit_status = 0;
 
-    const char** positionals = malloc(sizeof(char*) * (argc - 1));  // It's 2024. I am very rich!
+    const char* positionals[argc];
     size_t positional_count = 0;
     size_t positional_required = 1;
     const char* outfname = NULL;
-    char* source_str = NULL;
+    const char* chars_arg = NULL;
+    const char* charfname = NULL;
     const char* pbmfname = NULL;
+    const char* socket_path = NULL;
+    const char* subsetfname = NULL;
+    ServerOptions server_options = {.show_stats = false};
+    FILE* file = NULL;
+    FILE* outfile = NULL;
+    LoadedFont* font = NULL;
+    Arena arena = {};  // everything of this run but the font. sized from the input length
+    size_t thread_count = 1;
+    BitmapEncoding encoding = RAW_ENCODING;
+    bool show_encoding_stats = false;
+    bool show_utf8_stats = false;
+    bool async_log = false;
+    bool show_memory_stats = false;
+    size_t riff_depth = SIZE_MAX;
 
     for (int i = 1; i < argc; i++) {
         if (match_arg(argv[i], '\0', "log-level")) {
@@ -82,12 +107,27 @@ int main(int argc, const char** argv) {
             }
             set_log_level(parse_log_level(argv[i + 1]));
             ++i;
+        } else if (match_arg(argv[i], '\0', "async-log")) {
+            async_log = true;
         } else if (match_arg(argv[i], 'h', "help")) {
             print_help();
             return 0;
         } else if (match_arg(argv[i], '\0', "riff-view")) {
             mode = RIFF_VIEW_MODE;
             positional_required = 1;  // source
+        } else if (match_arg(argv[i], '\0', "riff-depth")) {
+            if (i == argc - 1) {
+                SIMPLE_LOG(FATAL, "riff-depth requires one argument but none was given");
+                return 1;
+            }
+            char* end;
+            long depth = strtol(argv[i + 1], &end, 10);
+            if (depth < 0 || *end != '\0' || end == argv[i + 1]) {
+                SIMPLE_LOG(FATAL, "invalid riff depth %s", argv[i + 1]);
+                return 1;
+            }
+            riff_depth = depth;
+            ++i;
         } else if (match_arg(argv[i], 'o', "output")) {
             if (i == argc - 1) {
                 SIMPLE_LOG(FATAL, "output requires one argument but none was given");
@@ -100,26 +140,16 @@ int main(int argc, const char** argv) {
                 SIMPLE_LOG(FATAL, "chars requires one argument but none was given");
                 return 1;
             }
-            size_t len = strlen(argv[i + 1]) + 1;
-            source_str = malloc(len);
-            strncpy(source_str, argv[i + 1], len - 1);
-            source_str[len - 1] = '\0';
+            chars_arg = argv[i + 1];
+            charfname = NULL;
             ++i;
         } else if (match_arg(argv[i], 'C', "charfile")) {
             if (i == argc - 1) {
                 SIMPLE_LOG(FATAL, "charfile requires one argument but none was given");
                 return 1;
             }
-            const char* fname = argv[i + 1];
-            struct stat charf_stat;
-            stat(fname, &charf_stat);
-            FILE* charfile = fopen(fname, "r");
-            size_t len = charf_stat.st_size + 1;
-            source_str = malloc(len);
-            source_str[len - 1] = '\0';
-            fread(source_str, sizeof(char), len, charfile);
-            fclose(charfile);
-
+            charfname = argv[i + 1];
+            chars_arg = NULL;
             ++i;
         } else if (match_arg(argv[i], '\n', "pbm-output")) {
             if (i == argc - 1) {
@@ -128,6 +158,54 @@ int main(int argc, const char** argv) {
             }
             pbmfname = argv[i + 1];
             ++i;
+        } else if (match_arg(argv[i], '\0', "encoding")) {
+            if (i == argc - 1) {
+                SIMPLE_LOG(FATAL, "encoding requires one argument but none was given");
+                return 1;
+            }
+            if (not parse_bitmap_encoding(argv[i + 1], &encoding)) {
+                SIMPLE_LOG(FATAL, "unknown encoding %s", argv[i + 1]);
+                return 1;
+            }
+            ++i;
+        } else if (match_arg(argv[i], '\0', "encoding-stats")) {
+            show_encoding_stats = true;
+        } else if (match_arg(argv[i], '\0', "utf8-stats")) {
+            show_utf8_stats = true;
+        } else if (match_arg(argv[i], '\0', "subset-header")) {
+            if (i == argc - 1) {
+                SIMPLE_LOG(FATAL, "subset-header requires one argument but none was given");
+                return 1;
+            }
+            mode = SUBSET_MODE;
+            subsetfname = argv[i + 1];
+            ++i;
+        } else if (match_arg(argv[i], 'j', "threads")) {
+            if (i == argc - 1) {
+                SIMPLE_LOG(FATAL, "threads requires one argument but none was given");
+                return 1;
+            }
+            long count = strtol(argv[i + 1], NULL, 10);
+            if (count < 1) {
+                SIMPLE_LOG(FATAL, "invalid thread count %s", argv[i + 1]);
+                return 1;
+            }
+            thread_count = count;
+            ++i;
+        } else if (match_arg(argv[i], '\0', "serve")) {
+            mode = SERVE_MODE;
+        } else if (match_arg(argv[i], '\0', "socket")) {
+            if (i == argc - 1) {
+                SIMPLE_LOG(FATAL, "socket requires one argument but none was given");
+                return 1;
+            }
+            mode = SERVE_MODE;
+            socket_path = argv[i + 1];
+            ++i;
+        } else if (match_arg(argv[i], '\0', "stats")) {
+            server_options.show_stats = true;
+        } else if (match_arg(argv[i], '\0', "memory-stats")) {
+            show_memory_stats = true;
         } else if (is_option(argv[i])) {
             SIMPLE_LOG(FATAL, "unknown argument %s", argv[i]);
             return -1;
@@ -137,6 +215,10 @@ int main(int argc, const char** argv) {
         }
     }
 
+    if (async_log && not simple_log_start_async()) {
+        SIMPLE_LOG(WARNING, "failed to start log thread. logging synchronously");
+    }
+
     if (positional_count < positional_required) {
         SIMPLE_LOG(FATAL, "insufficient positional argument");
         return 1;
@@ -147,170 +229,124 @@ int main(int argc, const char** argv) {
             SIMPLE_LOG(FATAL, "required argument 'output' is missing");
             return 1;
         }
-        if (source_str == NULL) {
+        if (chars_arg == NULL && charfname == NULL) {
             SIMPLE_LOG(FATAL, "required argument 'char' or 'charfile' is missing");
             return 1;
         }
     }
+    if (mode == SUBSET_MODE && chars_arg == NULL && charfname == NULL) {
+        SIMPLE_LOG(FATAL, "required argument 'char' or 'charfile' is missing");
+        return 1;
+    }
 
-    FILE* file = fopen(positionals[0], "rb");
-    if (file == NULL) {
-        SIMPLE_LOG(FATAL, "failed to open font file");
-        exit_status = 1;
+    if (mode == RIFF_VIEW_MODE) {
+        file = fopen(positionals[0], "rb");
+        if (file == NULL) {
+            SIMPLE_LOG(FATAL, "failed to open font file");
+            exit_status = 1;
+            goto quit;
+        }
+        RIFFHeaderInfo header = riff_open(file);
+        if (header.form_id == FOURCC("NULL")) {
+            SIMPLE_LOG(FATAL, "failed to parse riff header");
+            exit_status = 1;
+            goto quit;
+        }
+        printf("RIFF size: %u form: '%s'\n", header.size, cfourcc(header.form_id));
+        RIFFCursor cursor = riff_cursor_open(file, &header);
+        visit_riff_list(&cursor, 0, riff_depth);
+        if (cursor.error) {
+            SIMPLE_LOG(FATAL, "failed to parse chunk header");
+            exit_status = 1;
+        }
         goto quit;
     }
 
-    RIFFHeaderInfo header = riff_open(file);
-    if (header.form_id == FOURCC("NULL")) {
-        SIMPLE_LOG(FATAL, "failed to parse riff header");
+    font = font_open(positionals[0]);
+    if (font == NULL) {
         exit_status = 1;
         goto quit;
     }
 
-    if (mode == RIFF_VIEW_MODE) {
-        printf("RIFF size: %u form: '%s'\n", header.size, cfourcc(header.form_id));
+    if (mode == SERVE_MODE) {
+        if (socket_path != NULL) {
+            exit_status = serve_unix_socket(font, socket_path, &server_options);
+        } else {
+            exit_status = serve_stream(font, stdin, stdout, &server_options);
+        }
+        goto quit;
     }
 
-    uint32_t parsed_len = 4;  // format name
-    PlainChunkList* chunklist = new_list();
-    while (parsed_len < header.size) {
-        RIFFChunkInfo info = riff_read_chunk_info(file);
-        if (info.type == ERROR_CHUNK) {
-            SIMPLE_LOG(FATAL, "failed to parse chunk header");
+    FILE* charfile = NULL;
+    size_t source_len;
+    if (charfname != NULL) {
+        struct stat charf_stat;
+        if ((charfile = fopen(charfname, "rb")) == NULL || fstat(fileno(charfile), &charf_stat) == -1) {
+            SIMPLE_LOG(FATAL, "failed to open charfile %s", charfname);
+            if (charfile) {
+                fclose(charfile);
+            }
             exit_status = 1;
             goto quit;
         }
-        parsed_len += PLAININFO(info).totalsize;
-        if (mode == RIFF_VIEW_MODE) {
-            printf("- '%s' size: %u offset: %ld", cfourcc(PLAININFO(info).chunk_id), PLAININFO(info).size,
-                   PLAININFO(info).pos);
-        }
-        if (info.type == LIST) {
-            if (mode == RIFF_VIEW_MODE) {
-                printf(" type: '%s'\n", cfourcc(info.info.list.list_type));
-            }
-            visit_riff_list(file, PLAININFO(info).size, 1, chunklist);
-        } else {
-            RIFFPlainChunkInfo plain = PLAININFO(info);
-            list_append(chunklist, &plain);
-            riff_skip_chunk(file, &plain);
-            if (mode == RIFF_VIEW_MODE) {
-                printf("\n");
-            }
-        }
+        source_len = charf_stat.st_size;
+    } else {
+        source_len = strlen(chars_arg);
     }
-    if (mode == RIFF_VIEW_MODE) {
-        goto quit;
+    // the one reservation of the run. utf32 has as many codepoints as source bytes at most
+    size_t arena_size = arena_size_of(source_len + 1) + arena_size_of(sizeof(char32_t) * (source_len + 1));
+    if (mode == LOAD_FONT_MODE) {
+        arena_size += font_render_arena_size(font, source_len + 1, thread_count);
     }
-    RIFFPlainChunkInfo* meta = search_list(chunklist, FOURCC("FTMT"));
-    if (meta == NULL) {
-        SIMPLE_LOG(FATAL, "FTMT chunk was not found");
+    if (not arena_init(&arena, arena_size)) {
+        if (charfile) {
+            fclose(charfile);
+        }
         exit_status = 1;
         goto quit;
     }
-#define MIN_VER 2
-    uint16_t version;
-    uint16_t namelen;
-    char* name;
-    riff_rewind_chunk(file, meta);
-    fread(&version, sizeof(version), 1, file);
-    SIMPLE_LOG(INFO, "format version: %d", version);
-    if (version < MIN_VER) {
-        SIMPLE_LOG(FATAL, "format is older than %d", MIN_VER);
-        exit_status = 1;
-        goto quit;
+    char* source_str = arena_alloc(&arena, source_len + 1);
+    if (charfile != NULL) {
+        source_len = fread(source_str, sizeof(char), source_len, charfile);
+        fclose(charfile);
+    } else {
+        memcpy(source_str, chars_arg, source_len);
     }
-    fread(&namelen, sizeof(namelen), 1, file);
-    name = malloc(sizeof(char) * (namelen + 1));
-    fread(name, sizeof(char), namelen, file);
-    name[namelen + 1 - 1] = '\0';  // last index is length-1
-    SIMPLE_LOG(INFO, "font name: %s", name);
+    source_str[source_len] = '\0';
 
-    const char* target_str = source_str;
-    size_t maxlen = strlen(target_str) + 1;  // WARN: assuming c string with utf8
-    size_t buflen = sizeof(char32_t) * maxlen;
-    char32_t* utf32_chars = malloc(buflen);
-    memset(utf32_chars, 0, buflen);
-    char32_t* cursor = utf32_chars;
-    size_t parsed_strlen = 0;
-    size_t diff = -1;
-    size_t utf32_strlen = 0;
-    while (parsed_strlen < maxlen && diff != 0) {  // diff is 0 when it reaches NUL char
-        *cursor = cstr_to_codepoint_native(target_str, &diff);
-        target_str += diff;
-        parsed_strlen += diff;
-        cursor++;
-        utf32_strlen++;
+    if (show_utf8_stats) {
+        report_utf8_transcoding(stderr, source_str, strlen(source_str));
     }
-    cursor = utf32_chars;
-
-    free(source_str);
-    target_str = source_str = NULL;
-
-    uint16_t max_width;
-    uint16_t height;
-    RIFFPlainChunkInfo* glyph_meta = search_list(chunklist, FOURCC("GLMT"));
-    if (glyph_meta == NULL) {
-        SIMPLE_LOG(FATAL, "GLMT chunk was not found");
+    size_t utf32_strlen;
+    char32_t* utf32_chars = cstr_to_utf32(source_str, &utf32_strlen, &arena);
+    if (utf32_chars == NULL) {
         exit_status = 1;
         goto quit;
     }
-    riff_rewind_chunk(file, glyph_meta);
-    fread(&max_width, sizeof(max_width), 1, file);
-    fread(&height, sizeof(height), 1, file);
-    if (height != 16) {
-        SIMPLE_LOG(FATAL, "unsupported glyph height %d", height);
-    }
-    size_t bitmap_maxlen = (max_width + 2) * utf32_strlen;  // absolute maximum
-    uint16_t* bitmap = malloc(sizeof(uint16_t) * bitmap_maxlen);
-    size_t bitmap_len = 0;
-    size_t maxlinecount = utf32_strlen;
-    size_t* linewidths = malloc(sizeof(size_t) * maxlinecount);
-    size_t* lineends = malloc(sizeof(size_t) * maxlinecount);
-    size_t linecount = 0;
-    size_t previous_bitmap_len = 0;
 
-    PlainChunkList* glyphlist = new_list();
-    list_seek_head(&chunklist);
-    while (chunklist->next != NULL) {
-        if ((not list_is_sentinel(chunklist)) && chunklist->info.chunk_id == FOURCC("GLSP")) {
-            list_append(glyphlist, &chunklist->info);
+    if (mode == SUBSET_MODE) {
+        SubsetFont subset;
+        if (not build_subset(font, utf32_chars, &subset)) {
+            exit_status = 1;
+        } else if ((outfile = fopen(subsetfname, "w")) == NULL) {
+            SIMPLE_LOG(FATAL, "failed to open subset header file");
+            exit_status = 1;
+        } else {
+            write_subset_header(outfile, &subset, font->name);
+            report_subset(stdout, font, &subset, utf32_chars, utf32_strlen);
         }
-        chunklist = chunklist->next;
+        free_subset(&subset);
+        goto quit;
     }
 
-    while (*cursor != '\0') {
-        if (*cursor == '\n') {
-            linewidths[linecount] = bitmap_len - previous_bitmap_len;
-            previous_bitmap_len = bitmap_len;
-            lineends[linecount] = bitmap_len;
-            linecount++;
-            cursor++;
-            continue;
-        }
-        uint32_t gid = search_char(file, chunklist, *cursor);
-        if (gid == -1) {
-            SIMPLE_LOG(ERROR, "character 0x%04x wasn't found", *cursor);
-            cursor++;
-            continue;
-        }
-        SIMPLE_LOG(INFO, "ch: 0x%06X gid: 0x%04X", *cursor, gid);
-        size_t diff = 0;
-        diff = search_glyph(file, glyphlist, gid, bitmap + bitmap_len);
-        bitmap_len += diff;
-        cursor++;
-    }
-    if (linecount == 0) {
-        linecount = 1;
-        linewidths[0] = bitmap_len;
-        lineends[0] = bitmap_len;
-    }
+    RenderedText text;
+    font_render_parallel(font, utf32_chars, utf32_strlen, thread_count, &arena, &text);
 
-    FILE* outfile = fopen(outfname, "wb");
+    outfile = fopen(outfname, "wb");
     if (outfile == NULL) {
         SIMPLE_LOG(FATAL, "failed to open output file");
         exit_status = 1;
-        goto quit;  // NOTE: this results in fclose(NULL), which may be problematic
+        goto quit;
     }
     FILE* pbmfile = NULL;
     if (pbmfname != NULL) {
@@ -327,234 +363,53 @@ int main(int argc, const char** argv) {
         goto quit;
     }
     if (pbmfile != NULL) {
-        fprintf(pbmfile, "P4\n16 %zu\n", bitmap_len);
-    }
-
-    fprintf(outfile, "uint16_t bitmap[] = {\n    ");
-    for (size_t i = 0; i < bitmap_len; i++) {
-        fprintf(outfile, "0x%X, ", bitmap[i]);
-        if (pbmfile != NULL) {
-            uint8_t upper = (bitmap[i] & 0xff00) >> 8;
-            uint8_t lower = bitmap[i] & 0xff;
-            fwrite(&upper, sizeof(uint8_t), 1, pbmfile);
-            fwrite(&lower, sizeof(uint8_t), 1, pbmfile);
+        write_pbm(pbmfile, &text);
+        if (pbmfile != stdout) {
+            fclose(pbmfile);
         }
     }
-    if (pbmfile != NULL && pbmfile != stdout) {
-        fclose(pbmfile);
-    }
-    fprintf(outfile, "\n};\n");
-    fprintf(outfile, "size_t line_widths[] = {\n    ");
-    for (size_t i = 0; i < linecount; i++) {
-        fprintf(outfile, "%zu, ", linewidths[i]);
+
+    if (not write_encoded_bitmap(outfile, &text, encoding)) {
+        exit_status = 1;
     }
-    fprintf(outfile, "\n};\n");
-    fprintf(outfile, "size_t line_ends[] = {\n    ");
-    for (size_t i = 0; i < linecount; i++) {
-        fprintf(outfile, "%zu, ", lineends[i]);
+    write_line_tables(outfile, &text);
+    if (show_encoding_stats) {
+        report_bitmap_encodings(stderr, &text);
     }
-    fprintf(outfile, "\n};\n");
 
 quit:
+    if (show_memory_stats && font != NULL) {
+        report_arena(stderr, "font", &font->arena);
+        report_arena(stderr, "run", &arena);
+    }
     if (file) {
         fclose(file);
     }
     if (outfile) {
         fclose(outfile);
     }
-    if (positionals) {
-        free(positionals);
-    }
-    if (chunklist) {
-        free_list(chunklist);
-    }
-    if (glyphlist) {
-        free_list(glyphlist);
-    }
+    arena_free(&arena);
+    font_close(font);
     return exit_status;
 }
 
-void visit_riff_list(FILE* file, uint32_t total, int indent, PlainChunkList* chunklist) {
-    RIFFChunkInfo info;
-    uint32_t parsed_len = 4;
-    while (parsed_len < total) {
-        RIFFChunkInfo info = riff_read_chunk_info(file);
-        if (PLAININFO(info).chunk_id == FOURCC("NULL")) {
-            SIMPLE_LOG(FATAL, "failed to parse chunk header");
-            return;
-        }
-        parsed_len += PLAININFO(info).totalsize;
-        if (mode == RIFF_VIEW_MODE) {
-            for (int i = 0; i < indent; i++) {
-                printf(INDENT);
-            }
-            printf("- '%s' size: %u offset: %ld", cfourcc(PLAININFO(info).chunk_id), PLAININFO(info).size,
-                   PLAININFO(info).pos);
+void visit_riff_list(RIFFCursor* cursor, size_t depth, size_t max_depth) {
+    while (riff_cursor_next(cursor)) {
+        RIFFPlainChunkInfo info = PLAININFO(cursor->chunk);
+        for (size_t i = 0; i < depth; i++) {
+            printf(INDENT);
         }
-
-        if (info.type == LIST) {
-            if (mode == RIFF_VIEW_MODE) {
-                printf(" type: '%s'\n", cfourcc(info.info.list.list_type));
-            }
-            visit_riff_list(file, PLAININFO(info).size, indent + 1, chunklist);
+        printf("- '%s' size: %u offset: %ld", cfourcc(info.chunk_id), info.size, info.pos);
+
+        if (cursor->chunk.type != LIST) {
+            printf("\n");
+        } else if (depth < max_depth) {
+            printf(" type: '%s'\n", cfourcc(cursor->chunk.info.list.list_type));
+            RIFFCursor list = riff_cursor_descend(cursor);
+            visit_riff_list(&list, depth + 1, max_depth);
+            cursor->error = list.error;
         } else {
-            RIFFPlainChunkInfo plain = PLAININFO(info);
-            list_append(chunklist, &plain);
-            riff_skip_chunk(file, &plain);
-            if (mode == RIFF_VIEW_MODE) {
-                printf("\n");
-            }
-        }
-    }
-}
-
-// taken from my mod on cmatrix
-#define c_die(msg)              \
-    do {                        \
-        SIMPLE_LOG(FATAL, msg); \
-        return -1;              \
-    } while (false)
-
-char32_t cstr_to_codepoint_utf8(const char* cstr, size_t* n_used_cstr) {
-    uint32_t result = 0;
-    size_t n = 1;
-    if (cstr[0] == '\0') {
-        result = '\0';
-        n = 0;
-    } else if ((*cstr & 0x80) == 0) {
-        result = *cstr;
-        n = 1;
-    } else if ((*cstr & 0xe0) == 0xc0) {
-        result |= (*cstr & 0x1f) << 6;
-        cstr++;
-        n++;
-        if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
-        result |= (*cstr & 0x3f);
-        if (result < 0x0080) c_die("Invalid utf8 sequence");
-    } else if ((*cstr & 0xf0) == 0xe0) {
-        result |= (*cstr & 0x0f) << 12;
-        for (int i = 2; i > 0; i--) {
-            cstr++;
-            n++;
-            if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
-            result |= (*cstr & 0x3f) << (6 * (i - 1));
-        }
-        if (result < 0x0800) c_die("Invalid utf8 sequence");
-    } else if ((*cstr & 0xf8) == 0xf0) {
-        result |= (*cstr & 0x07) << 18;
-        for (int i = 3; i > 0; i--) {
-            cstr++;
-            n++;
-            if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
-            result |= (*cstr & 0x3f) << (6 * (i - 1));
-        }
-        if (result < 0x10000) c_die("Invalid utf8 sequence");
-    } else {
-        c_die("Invalid utf8 sequence");
-    }
-    if (result > 0x10ffff) {
-        c_die("Invalid utf8 sequence");
-    }
-    if (n_used_cstr != NULL) {
-        *n_used_cstr = n;
-    }
-    return result;
-}
-
-char32_t cstr_to_codepoint_native(const char* cstr, size_t* n_used_cstr) {
-    // some environment specific things will be here
-    return cstr_to_codepoint_utf8(cstr, n_used_cstr);
-}
-
-#define SAFE_MEAN(a, b) (((a) / 2) + ((b) / 2) + (((a) % 2) + ((b) % 2)) / 2)
-
-uint32_t bin_search_char(FILE* file, const RIFFPlainChunkInfo* cmap, char32_t ch, size_t itemsize, size_t charsize,
-                         long range_min, long range_max) {
-    if (range_min > range_max) {  // just in case
-        return -1;                // gid is 16 bit, so 32bit 0xffs is out of range
-    }
-    long pivot = SAFE_MEAN(range_min, range_max);
-    char32_t pivot_ch = 0;
-    riff_seek_in_chunk(file, cmap, itemsize * pivot);
-    fread(&pivot_ch, charsize, 1, file);
-    SIMPLE_LOG(DEBUG, "pivot: %u chsize: %u ch: %04x pivot_ch: %04x, range_min: %ld, range_max: %ld", pivot, charsize,
-               ch, pivot_ch, range_min, range_max);
-    if (pivot_ch == ch) {
-        uint16_t pivot_gid;
-        fread(&pivot_gid, sizeof(uint16_t), 1, file);
-        return pivot_gid;
-    } else if (range_min == range_max) {
-        return -1;
-    } else if (pivot_ch < ch) {
-        return bin_search_char(file, cmap, ch, itemsize, charsize, pivot, range_max);
-    } else {
-        return bin_search_char(file, cmap, ch, itemsize, charsize, range_min, pivot);
-    }
-}
-
-uint32_t search_char(FILE* file, PlainChunkList* chunklist, char32_t ch) {
-    FourCC cmap_id;
-    size_t itemsize;
-    size_t charsize;
-    if (ch <= 0xff) {
-        cmap_id = FOURCC("CM1B");
-        charsize = 1;
-    } else if (ch <= 0xff'ff) {
-        cmap_id = FOURCC("CM2B");
-        charsize = 2;
-    } else if (ch <= 0xff'ff'ff) {
-        cmap_id = FOURCC("CM3B");
-        charsize = 3;
-    } else {
-        cmap_id = FOURCC("CM4B");
-        charsize = 4;
-    }
-    itemsize = charsize + 2;
-    RIFFPlainChunkInfo* cmap = search_list(chunklist, cmap_id);
-    if (cmap == NULL) {
-        SIMPLE_LOG(ERROR, "%s chunk not found", cfourcc(cmap_id));
-        return -1;
-    }
-    size_t itemcount = cmap->size / itemsize;
-    if (cmap->size % itemsize != 0) {
-        SIMPLE_LOG(ERROR, "the size of cmap %s (%lu) is not multiple of itemsize (%lu)", cfourcc(cmap->chunk_id),
-                   cmap->size, itemsize);
-    }
-    SIMPLE_LOG(DEBUG, "cmap: %s itemcount: %d", cfourcc(cmap->chunk_id), itemcount);
-    return bin_search_char(file, cmap, ch, itemsize, charsize, 0, itemcount - 1);
-}
-size_t search_glyph(FILE* file, PlainChunkList* glyphlist, uint16_t gid, uint16_t* bitmap_buf) {
-    list_seek_head(&glyphlist);
-    while (glyphlist->next != NULL) {
-        if ((not list_is_sentinel(glyphlist))) {
-            uint16_t first_gid;
-            uint16_t last_gid;
-            riff_rewind_chunk(file, &glyphlist->info);
-            fread(&first_gid, sizeof(first_gid), 1, file);
-            fread(&last_gid, sizeof(last_gid), 1, file);
-            if (first_gid <= gid && gid <= last_gid) {
-                uint16_t width;
-                uint16_t result;
-                fread(&width, sizeof(width), 1, file);
-                SIMPLE_LOG(DEBUG, "gid: 0x%x, width: %d", gid, width);
-                riff_seek_in_chunk(file, &glyphlist->info,
-                                   sizeof(uint16_t) * 3 + (sizeof(uint16_t) * width * (gid - first_gid)));
-                fread(bitmap_buf, sizeof(uint16_t), width, file);
-                result = width;
-                // insert space between character if it's not in font
-                if (bitmap_buf[0] != 0) {
-                    memmove(bitmap_buf + 1, bitmap_buf,
-                            sizeof(uint16_t) * width);  // since to area is overwrapping, memcpy cannot be used
-                    ++result;
-                }
-                if (bitmap_buf[result - 1] != 0) {
-                    bitmap_buf[result] = 0;
-                    ++result;
-                }
-                return result;
-            }
+            printf(" type: '%s' ...\n", cfourcc(cursor->chunk.info.list.list_type));  // skipped in one step
         }
-        glyphlist = glyphlist->next;
     }
-    return 0;
 }
@@ -0,0 +1,34 @@
+# run by ctest. writes a synthetic font with conv_font, packs its sources with pack_font and compares the two files.
+# defined by the test: PYTHON, SYNTH, PACK_FONT, WORK_DIR, VERSION, HEIGHT, GLYPHS, SHUFFLE_RATIO and
+# CMAP_HASH (ON or OFF)
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(HASH_ARG)
+if(CMAP_HASH)
+    set(HASH_ARG --cmap-hash)
+endif()
+
+execute_process(
+    COMMAND ${PYTHON} ${SYNTH} --log-level WARNING --glyphs ${GLYPHS} --height ${HEIGHT} --format-version ${VERSION}
+            --shuffle-ratio ${SHUFFLE_RATIO} ${HASH_ARG} --dst conv_font.fhft --dump-sources sources
+    WORKING_DIRECTORY ${WORK_DIR}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "synth.py failed: ${result}")
+endif()
+
+# synth.py names the font after its glyph count and height
+execute_process(
+    COMMAND ${PACK_FONT} --format-version ${VERSION} ${HASH_ARG} --name "synthetic ${GLYPHS} glyphs ${HEIGHT}px"
+            sources/glyphs.bin sources/cmap.bin pack_font.fhft
+    WORKING_DIRECTORY ${WORK_DIR}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pack_font failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files conv_font.fhft pack_font.fhft WORKING_DIRECTORY ${WORK_DIR}
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "pack_font output differs from conv_font's in ${WORK_DIR}")
+endif()
@@ -0,0 +1,503 @@
+#include <iso646.h>
+#include <riff_reader.h>
+#include <riff_writer.h>
+#include <simple_logging.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font.h"
+
+#define DEFAULT_VERSION 4
+#define INDEXED_VER 3  // FDIR and aligned bitmaps
+#define RANGED_VER 4   // CMRG
+#define BITMAP_ALIGNMENT 8
+#define GLSP_HEADER_SIZE (8 + 6)  // chunk header, first_gid, last_gid, width
+#define FDIR_ENTRY_SIZE 12        // chunk id, position, size
+#define COPY_BLOCK_SIZE 65536
+
+void print_help() {
+    printf("pack_font: write FixedHeightFont file from glyphs.bin and cmap.bin of conv_font --dump-sources\n");
+    printf("           the output is identical to conv_font's, but glyphs and cmap are streamed to the file\n");
+    printf("usage: pack_font [options] glyphs.bin cmap.bin output\n");
+    printf("options: \n");
+    printf("--log-level <level>      set log level to <level>\n");
+    printf("                         <level> can be: DEBUG, INFO, WARNING, ERROR, FATAL\n");
+    printf("--format-version <ver>   FixedHeightFont format version. 2, 3 or 4. default: %d\n", DEFAULT_VERSION);
+    printf("--name <name>            font name\n");
+    printf("--cmap-hash              add precomputed cmap hash table\n");
+    printf("-h/--help                show this help\n");
+}
+
+typedef struct {
+    FILE* file;
+    uint16_t max_width;
+    uint16_t height;
+    size_t column_size;
+    size_t range_count;
+} GlyphSource;
+
+// item of cmap.bin
+typedef struct {
+    uint32_t codepoint;
+    uint16_t gid;
+    uint16_t reserved;
+} CmapItem;
+
+typedef struct {
+    FILE* file;
+    size_t item_count;
+    bool has_next;
+    CmapItem next;  // first item after the last run read
+    bool error;
+} CmapSource;
+
+// maximal run of consecutive codepoints mapped to consecutive gids
+typedef struct {
+    uint32_t first_codepoint;
+    uint32_t last_codepoint;
+    uint16_t first_gid;
+    size_t table_bytes;  // size of the items of the run in CMxB tables
+} CmapRun;
+
+typedef struct {
+    RIFFWriter writer;
+    long directory_pos;  // data of FDIR, or -1 without directory
+    uint32_t directory_len;
+    bool cmap_ranges;    // CMRG is written
+    bool coalesce_runs;  // runs are written to CMRG instead of CMxB. see decide_cmap_ranges
+} Packer;
+
+static uint8_t copy_block[COPY_BLOCK_SIZE];
+
+// read GLMT and walk every range, so that the directory can be sized before anything is written
+static bool open_glyph_source(const char* path, GlyphSource* source) {
+    source->file = fopen(path, "rb");
+    if (source->file == NULL) {
+        SIMPLE_LOG(FATAL, "failed to open %s", path);
+        return false;
+    }
+    uint16_t metadata[2];
+    if (fread(metadata, sizeof(metadata), 1, source->file) != 1) {
+        SIMPLE_LOG(FATAL, "%s is too short for glyph metadata", path);
+        return false;
+    }
+    source->max_width = metadata[0];
+    source->height = metadata[1];
+    source->column_size = column_size_for_height(source->height);
+    if (source->column_size == 0) {
+        SIMPLE_LOG(FATAL, "unsupported glyph height %u", source->height);
+        return false;
+    }
+    source->range_count = 0;
+    uint16_t header[3];  // first_gid, last_gid, width
+    while (fread(header, sizeof(header), 1, source->file) == 1) {
+        if (header[0] > header[1]) {
+            SIMPLE_LOG(FATAL, "glyph range %zu of %s is reversed", source->range_count, path);
+            return false;
+        }
+        long bitmap_len = source->column_size * header[2] * (header[1] - header[0] + 1);
+        if (fseek(source->file, bitmap_len, SEEK_CUR) != 0) {
+            SIMPLE_LOG(FATAL, "failed to skip glyph range %zu of %s", source->range_count, path);
+            return false;
+        }
+        source->range_count++;
+    }
+    long end = ftell(source->file);
+    if (fseek(source->file, 0, SEEK_END) != 0 || ftell(source->file) != end) {
+        SIMPLE_LOG(FATAL, "%s ends in the middle of a glyph range", path);
+        return false;
+    }
+    fseek(source->file, sizeof(metadata), SEEK_SET);
+    SIMPLE_LOG(INFO, "%zu glyph ranges, height %u", source->range_count, source->height);
+    return true;
+}
+
+static bool open_cmap_source(const char* path, CmapSource* source) {
+    source->file = fopen(path, "rb");
+    if (source->file == NULL || fseek(source->file, 0, SEEK_END) != 0) {
+        SIMPLE_LOG(FATAL, "failed to open %s", path);
+        return false;
+    }
+    long len = ftell(source->file);
+    if (len % sizeof(CmapItem) != 0) {
+        SIMPLE_LOG(FATAL, "size of %s is not a multiple of %zu", path, sizeof(CmapItem));
+        return false;
+    }
+    source->item_count = len / sizeof(CmapItem);
+    rewind(source->file);
+    return true;
+}
+
+// bytes of codepoint in CMxB tables. the same as conv_font's CMAPItem
+static size_t codepoint_size(uint32_t codepoint) {
+    if (codepoint <= 0xFF) {
+        return 1;
+    } else if (codepoint <= 0xFFFF) {
+        return 2;
+    } else if (codepoint <= 0xFF'FFFF) {
+        return 3;
+    }
+    return 4;
+}
+
+static bool add_directory_entry(Packer* packer, const RIFFPlainChunkInfo* info) {
+    if (packer->directory_pos < 0) {
+        return true;
+    }
+    uint32_t entry[3] = {info->chunk_id, info->pos, info->size};
+    long pos = packer->directory_pos + sizeof(uint32_t) + (long)packer->directory_len * FDIR_ENTRY_SIZE;
+    packer->directory_len++;
+    return riff_patch(&packer->writer, pos, entry, sizeof(entry));
+}
+
+// FDIR has fixed size, so it's written with empty entries here and filled as the chunks are written
+static bool reserve_directory(Packer* packer, uint32_t entry_count) {
+    RIFFWriter* writer = &packer->writer;
+    packer->directory_pos = riff_writer_tell(writer) + 8;
+    if (not riff_begin_chunk(writer, FOURCC("FDIR")) || not riff_write(writer, &entry_count, sizeof(entry_count))) {
+        return false;
+    }
+    memset(copy_block, 0, sizeof(copy_block));
+    for (size_t left = (size_t)entry_count * FDIR_ENTRY_SIZE; left > 0;) {
+        size_t len = left < sizeof(copy_block) ? left : sizeof(copy_block);
+        if (not riff_write(writer, copy_block, len)) {
+            return false;
+        }
+        left -= len;
+    }
+    return riff_end_chunk(writer, NULL);
+}
+
+static void rewind_cmap_source(CmapSource* source) {
+    rewind(source->file);
+    source->has_next = fread(&source->next, sizeof(source->next), 1, source->file) == 1;
+}
+
+// returns false at the end of cmap.bin, or if items are not sorted. source->error tells which
+static bool read_cmap_run(CmapSource* source, CmapRun* run) {
+    if (not source->has_next) {
+        return false;
+    }
+    *run = (CmapRun){source->next.codepoint, source->next.codepoint, source->next.gid,
+                     codepoint_size(source->next.codepoint) + sizeof(uint16_t)};
+    while ((source->has_next = fread(&source->next, sizeof(source->next), 1, source->file) == 1)) {
+        if (source->next.codepoint <= run->last_codepoint) {
+            SIMPLE_LOG(FATAL, "cmap items are not sorted by codepoint at U+%04X", source->next.codepoint);
+            source->error = true;
+            return false;
+        }
+        if (source->next.codepoint != run->last_codepoint + 1 ||
+            source->next.gid != run->first_gid + (source->next.codepoint - run->first_codepoint)) {
+            break;
+        }
+        run->last_codepoint++;
+        run->table_bytes += codepoint_size(run->last_codepoint) + sizeof(uint16_t);
+    }
+    return true;
+}
+
+static bool is_range_smaller(const CmapRun* run) { return run->table_bytes > CMAP_RANGE_SIZE; }
+
+// runs smaller as a range than as items go to CMRG. the same rule as conv_font's CMAPRanges.split
+static bool is_coalesced(const Packer* packer, const CmapRun* run) {
+    return packer->coalesce_runs && is_range_smaller(run);
+}
+
+static size_t bit_length(size_t n) {
+    size_t result = 0;
+    for (; n != 0; n >>= 1) {
+        result++;
+    }
+    return result;
+}
+
+// the same integer estimate as conv_font's CMAPRanges.pays_off: binary search steps of a lookup, summed over every
+// item. readers search CMRG first, so the items left in CMxB pay for both searches
+static bool ranges_pay_off(size_t item_count, size_t range_count, size_t rest_count) {
+    return item_count * bit_length(range_count) + rest_count * bit_length(rest_count) <
+           item_count * bit_length(item_count);
+}
+
+// runs go to CMRG only if searching it first makes lookups faster. otherwise CMRG is written empty
+static bool decide_cmap_ranges(Packer* packer, CmapSource* source) {
+    size_t range_count = 0;
+    size_t rest_count = 0;
+    rewind_cmap_source(source);
+    CmapRun run;
+    while (read_cmap_run(source, &run)) {
+        if (is_range_smaller(&run)) {
+            range_count++;
+        } else {
+            rest_count += run.last_codepoint - run.first_codepoint + 1;
+        }
+    }
+    if (source->error) {
+        return false;
+    }
+    packer->coalesce_runs = ranges_pay_off(source->item_count, range_count, rest_count);
+    SIMPLE_LOG(INFO, "%zu cmap ranges, %zu items left: %s", range_count, rest_count,
+               packer->coalesce_runs ? "coalesced" : "left in tables");
+    return true;
+}
+
+static bool begin_cmap_table(Packer* packer, size_t charsize) {
+    return riff_begin_chunk(&packer->writer, FOURCC("CM0B") + ((uint32_t)charsize << 16));
+}
+
+static bool end_cmap_table(Packer* packer) {
+    RIFFPlainChunkInfo info;
+    return riff_end_chunk(&packer->writer, &info) && add_directory_entry(packer, &info);
+}
+
+// items are split into CM1B..CM4B by codepoint size, which grows with codepoint. so one pass writes every table
+static bool write_cmap_tables(Packer* packer, CmapSource* source) {
+    size_t charsize = 1;
+    if (not begin_cmap_table(packer, charsize)) {
+        return false;
+    }
+    rewind_cmap_source(source);
+    CmapRun run;
+    while (read_cmap_run(source, &run)) {
+        if (is_coalesced(packer, &run)) {
+            continue;
+        }
+        for (uint64_t codepoint = run.first_codepoint; codepoint <= run.last_codepoint; codepoint++) {
+            while (codepoint_size(codepoint) > charsize) {
+                if (not end_cmap_table(packer) || not begin_cmap_table(packer, ++charsize)) {
+                    return false;
+                }
+            }
+            uint16_t gid = run.first_gid + (codepoint - run.first_codepoint);
+            if (not riff_write(&packer->writer, &codepoint, charsize) ||
+                not riff_write(&packer->writer, &gid, sizeof(gid))) {
+                return false;
+            }
+        }
+    }
+    if (source->error) {
+        return false;
+    }
+    while (charsize < CMAP_TABLE_COUNT) {
+        if (not end_cmap_table(packer) || not begin_cmap_table(packer, ++charsize)) {
+            return false;
+        }
+    }
+    return end_cmap_table(packer);
+}
+
+static bool write_cmap_ranges(Packer* packer, CmapSource* source) {
+    RIFFWriter* writer = &packer->writer;
+    if (not riff_begin_chunk(writer, FOURCC("CMRG"))) {
+        return false;
+    }
+    rewind_cmap_source(source);
+    CmapRun run;
+    while (read_cmap_run(source, &run)) {
+        if (not is_coalesced(packer, &run)) {
+            continue;
+        }
+        uint16_t gid_and_reserved[2] = {run.first_gid, 0};
+        if (not riff_write(writer, &run.first_codepoint, sizeof(run.first_codepoint)) ||
+            not riff_write(writer, &run.last_codepoint, sizeof(run.last_codepoint)) ||
+            not riff_write(writer, gid_and_reserved, sizeof(gid_and_reserved))) {
+            return false;
+        }
+    }
+    RIFFPlainChunkInfo info;
+    return not source->error && riff_end_chunk(writer, &info) && add_directory_entry(packer, &info);
+}
+
+// the table is built in memory, since probing needs random access. it holds 16 bytes or less per cmap item
+static bool write_cmap_hash(Packer* packer, CmapSource* source) {
+    uint32_t bits = 1;
+    while (((size_t)1 << bits) < source->item_count * 2) {
+        bits++;
+    }
+    uint32_t header[2] = {(uint32_t)1 << bits, 0};  // bucket count, reserved
+    uint32_t* buckets = malloc((size_t)header[0] * CMAP_HASH_BUCKET_SIZE);
+    if (buckets == NULL) {
+        SIMPLE_LOG(FATAL, "failed to allocate %u cmap hash buckets", header[0]);
+        return false;
+    }
+    for (uint32_t i = 0; i < header[0]; i++) {
+        buckets[i * 2] = CMAP_HASH_EMPTY;
+        buckets[i * 2 + 1] = 0;
+    }
+    rewind(source->file);
+    CmapItem item;
+    while (fread(&item, sizeof(item), 1, source->file) == 1) {
+        uint32_t index = (uint32_t)(item.codepoint * CMAP_HASH_MULTIPLIER) >> (32 - bits);
+        while (buckets[index * 2] != CMAP_HASH_EMPTY) {
+            index = (index + 1) & (header[0] - 1);
+        }
+        buckets[index * 2] = item.codepoint;
+        buckets[index * 2 + 1] = item.gid;
+    }
+    RIFFWriter* writer = &packer->writer;
+    RIFFPlainChunkInfo info;
+    bool result = riff_begin_chunk(writer, FOURCC("CMHS")) && riff_write(writer, header, sizeof(header)) &&
+                  riff_write(writer, buckets, (size_t)header[0] * CMAP_HASH_BUCKET_SIZE) &&
+                  riff_end_chunk(writer, &info) && add_directory_entry(packer, &info);
+    free(buckets);
+    return result;
+}
+
+// JUNK before GLSP, so that its bitmaps start at a multiple of BITMAP_ALIGNMENT. the same as conv_font's Junk
+static bool align_glyph_range(Packer* packer) {
+    long shift = (BITMAP_ALIGNMENT - (riff_writer_tell(&packer->writer) + GLSP_HEADER_SIZE) % BITMAP_ALIGNMENT) %
+                 BITMAP_ALIGNMENT;
+    if (shift == 0) {
+        return true;
+    }
+    memset(copy_block, 0, shift);
+    return riff_write_chunk(&packer->writer, FOURCC("JUNK"), copy_block, shift, NULL);
+}
+
+static bool write_glyph_range(Packer* packer, GlyphSource* source) {
+    RIFFWriter* writer = &packer->writer;
+    uint16_t header[3];  // first_gid, last_gid, width
+    if (fread(header, sizeof(header), 1, source->file) != 1) {
+        SIMPLE_LOG(FATAL, "glyphs.bin changed while packing");
+        return false;
+    }
+    if (not riff_begin_chunk(writer, FOURCC("GLSP")) || not riff_write(writer, header, sizeof(header))) {
+        return false;
+    }
+    for (size_t left = source->column_size * header[2] * (header[1] - header[0] + 1); left > 0;) {
+        size_t len = left < sizeof(copy_block) ? left : sizeof(copy_block);
+        if (fread(copy_block, 1, len, source->file) != len) {
+            SIMPLE_LOG(FATAL, "glyphs.bin changed while packing");
+            return false;
+        }
+        if (not riff_write(writer, copy_block, len)) {
+            return false;
+        }
+        left -= len;
+    }
+    RIFFPlainChunkInfo info;
+    return riff_end_chunk(writer, &info) && add_directory_entry(packer, &info);
+}
+
+static bool pack(FILE* out, uint16_t version, const char* name, bool cmap_hash, GlyphSource* glyphs,
+                 CmapSource* cmap) {
+    Packer packer = {
+        .writer = riff_writer_begin(out, FOURCC("FHFT")), .directory_pos = -1, .cmap_ranges = version >= RANGED_VER};
+    RIFFWriter* writer = &packer.writer;
+
+    uint16_t namelen = strlen(name);
+    if (not riff_begin_chunk(writer, FOURCC("FTMT")) || not riff_write(writer, &version, sizeof(version)) ||
+        not riff_write(writer, &namelen, sizeof(namelen)) || not riff_write(writer, name, namelen) ||
+        not riff_end_chunk(writer, NULL)) {
+        return false;
+    }
+    if (version >= INDEXED_VER) {
+        uint32_t entry_count =
+            CMAP_TABLE_COUNT + packer.cmap_ranges + cmap_hash + 1 + glyphs->range_count;  // 1 for GLMT
+        if (not reserve_directory(&packer, entry_count)) {
+            return false;
+        }
+    }
+
+    if (packer.cmap_ranges && not decide_cmap_ranges(&packer, cmap)) {
+        return false;
+    }
+    if (not riff_begin_list(writer, FOURCC("CMAP")) || not write_cmap_tables(&packer, cmap)) {
+        return false;
+    }
+    if (packer.cmap_ranges && not write_cmap_ranges(&packer, cmap)) {
+        return false;
+    }
+    if (cmap_hash && not write_cmap_hash(&packer, cmap)) {
+        return false;
+    }
+    if (not riff_end_chunk(writer, NULL)) {
+        return false;
+    }
+
+    uint16_t metadata[2] = {glyphs->max_width, glyphs->height};
+    RIFFPlainChunkInfo info;
+    if (not riff_begin_list(writer, FOURCC("GLYF")) ||
+        not riff_write_chunk(writer, FOURCC("GLMT"), metadata, sizeof(metadata), &info) ||
+        not add_directory_entry(&packer, &info) || not riff_begin_list(writer, FOURCC("SPLI"))) {
+        return false;
+    }
+    for (size_t i = 0; i < glyphs->range_count; i++) {
+        if (version >= INDEXED_VER && not align_glyph_range(&packer)) {
+            return false;
+        }
+        if (not write_glyph_range(&packer, glyphs)) {
+            return false;
+        }
+    }
+    return riff_writer_end(writer);
+}
+
+int main(int argc, const char** argv) {
+    uint16_t version = DEFAULT_VERSION;
+    const char* name = "";
+    bool cmap_hash = false;
+    const char* positionals[3];
+    size_t positional_count = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_help();
+            return 0;
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            set_log_level(parse_log_level(argv[++i]));
+        } else if (strcmp(argv[i], "--format-version") == 0 && i + 1 < argc) {
+            version = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--cmap-hash") == 0) {
+            cmap_hash = true;
+        } else if (positional_count < 3) {
+            positionals[positional_count++] = argv[i];
+        } else {
+            SIMPLE_LOG(FATAL, "too many arguments");
+            return 1;
+        }
+    }
+    if (positional_count < 3) {
+        SIMPLE_LOG(FATAL, "glyphs.bin, cmap.bin and output are required");
+        return 1;
+    }
+    if (version < 2 || version > RANGED_VER) {
+        SIMPLE_LOG(FATAL, "unsupported format version %u", version);
+        return 1;
+    }
+    if (strlen(name) > UINT16_MAX) {
+        SIMPLE_LOG(FATAL, "font name is too long");
+        return 1;
+    }
+
+    int exit_status = 1;
+    GlyphSource glyphs = {};
+    CmapSource cmap = {};
+    FILE* out = NULL;
+    if (not open_glyph_source(positionals[0], &glyphs) || not open_cmap_source(positionals[1], &cmap)) {
+        goto quit;
+    }
+    out = fopen(positionals[2], "wb");
+    if (out == NULL) {
+        SIMPLE_LOG(FATAL, "failed to open %s", positionals[2]);
+        goto quit;
+    }
+    if (pack(out, version, name, cmap_hash, &glyphs, &cmap)) {
+        exit_status = 0;
+    } else {
+        SIMPLE_LOG(FATAL, "failed to write %s", positionals[2]);
+    }
+quit:
+    if (out != NULL) {
+        fclose(out);
+    }
+    if (cmap.file != NULL) {
+        fclose(cmap.file);
+    }
+    if (glyphs.file != NULL) {
+        fclose(glyphs.file);
+    }
+    return exit_status;
+}
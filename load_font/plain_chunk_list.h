@@ -2,6 +2,8 @@
 #define LOAD_FONT_PLAIN_CHUNK_LIST
 #include <riff_reader.h>
 
+#include "arena.h"
+
 struct PlainChunkList;
 
 struct PlainChunkList {
@@ -16,17 +18,16 @@ bool list_is_head_sentinel(PlainChunkList* list);
 bool list_is_tail_sentinel(PlainChunkList* list);
 bool list_is_sentinel(PlainChunkList* list);
 
-// initialize sentinel
-PlainChunkList* new_list(void);
+// initialize sentinel. nodes live in arena and are released with it
+PlainChunkList* new_list(Arena* arena);
 
 void list_seek_head(PlainChunkList** list);
 
 void list_seek_tail(PlainChunkList** list);
 
 // the first and last item is sentinel
-void list_append(PlainChunkList* list, const RIFFPlainChunkInfo* info);
+void list_append(PlainChunkList* list, const RIFFPlainChunkInfo* info, Arena* arena);
 
 RIFFPlainChunkInfo* search_list(PlainChunkList* list, FourCC target_id);
 
-void free_list(PlainChunkList* list);
 #endif
@@ -0,0 +1,55 @@
+/*
+ * glyph copy and render loop for one column type.
+ * font.c includes this once per column type with these defined, so there is no include guard:
+ *   COLUMN_T         uint8_t, uint16_t, uint32_t or uint64_t
+ *   COLUMN_FN(name)  name suffixed with the column width
+ */
+
+static size_t COLUMN_FN(search_glyph)(const LoadedFont* font, uint16_t gid, COLUMN_T* bitmap_buf) {
+    uint16_t width;
+    const uint8_t* bitmap = font_glyph_bitmap(font, gid, &width);
+    if (bitmap == NULL) {
+        return 0;
+    }
+    SIMPLE_LOG(DEBUG, "gid: 0x%x, width: %d", gid, width);
+    if (width == 0) {
+        return 0;  // no columns to put space around. the same as subset_search_glyph
+    }
+    size_t result;
+    memcpy(bitmap_buf, bitmap, sizeof(COLUMN_T) * width);
+    result = width;
+    // insert space between character if it's not in font
+    if (bitmap_buf[0] != 0) {
+        memmove(bitmap_buf + 1, bitmap_buf,
+                sizeof(COLUMN_T) * width);  // since to area is overwrapping, memcpy cannot be used
+        bitmap_buf[0] = 0;
+        ++result;
+    }
+    if (bitmap_buf[result - 1] != 0) {
+        bitmap_buf[result] = 0;
+        ++result;
+    }
+    return result;
+}
+
+static void COLUMN_FN(render_range)(const LoadedFont* font, const char32_t* begin, const char32_t* end,
+                                    RenderedText* result) {
+    COLUMN_T* bitmap = result->bitmap;
+    size_t previous_bitmap_len = result->bitmap_len;
+    for (const char32_t* cursor = begin; cursor != end; cursor++) {
+        if (*cursor == '\n') {
+            result->line_widths[result->linecount] = result->bitmap_len - previous_bitmap_len;
+            previous_bitmap_len = result->bitmap_len;
+            result->line_ends[result->linecount] = result->bitmap_len;
+            result->linecount++;
+            continue;
+        }
+        uint32_t gid = font_search_char(font, *cursor);
+        if (gid == FONT_GID_NOT_FOUND) {
+            SIMPLE_LOG(ERROR, "character 0x%04x wasn't found", *cursor);
+            continue;
+        }
+        SIMPLE_LOG(INFO, "ch: 0x%06X gid: 0x%04X", *cursor, gid);
+        result->bitmap_len += COLUMN_FN(search_glyph)(font, gid, bitmap + result->bitmap_len);
+    }
+}
@@ -0,0 +1,237 @@
+#include "server.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <iso646.h>
+#include <signal.h>
+#include <simple_logging.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timing.h"
+#include "utf8.h"
+
+#define ACCEPT_BACKOFF_MIN_MS 10
+#define ACCEPT_BACKOFF_MAX_MS 1000
+
+typedef struct {
+    size_t requests;
+    size_t codepoints;
+    size_t columns;
+    double total_us;
+    double min_us;
+    double max_us;
+} ServerStats;
+
+// unescape in place. returns the new length
+static size_t unescape_request(char* line, size_t len) {
+    size_t dst = 0;
+    for (size_t src = 0; src < len; src++) {
+        if (line[src] == '\\' && src + 1 < len) {
+            if (line[src + 1] == 'n') {
+                line[dst++] = '\n';
+                src++;
+                continue;
+            } else if (line[src + 1] == '\\') {
+                line[dst++] = '\\';
+                src++;
+                continue;
+            }
+        }
+        line[dst++] = line[src];
+    }
+    line[dst] = '\0';
+    return dst;
+}
+
+// expanded once per column type, so the loop doesn't branch on the column size
+#define WRITE_HEX_COLUMNS(out, columns, len, format)                   \
+    for (size_t i = 0; i < (len); i++) {                               \
+        fprintf(out, i == 0 ? "%" format : " %" format, (columns)[i]); \
+    }
+
+static void write_response(FILE* out, const RenderedText* text) {
+    fprintf(out, "OK %zu %zu\n", text->bitmap_len, text->linecount);
+    switch (text->column_size) {
+        case sizeof(uint8_t):
+            WRITE_HEX_COLUMNS(out, text->bitmap8, text->bitmap_len, PRIX8);
+            break;
+        case sizeof(uint16_t):
+            WRITE_HEX_COLUMNS(out, text->bitmap16, text->bitmap_len, PRIX16);
+            break;
+        case sizeof(uint32_t):
+            WRITE_HEX_COLUMNS(out, text->bitmap32, text->bitmap_len, PRIX32);
+            break;
+        default:
+            WRITE_HEX_COLUMNS(out, text->bitmap64, text->bitmap_len, PRIX64);
+            break;
+    }
+    fprintf(out, "\n");
+    for (size_t i = 0; i < text->linecount; i++) {
+        fprintf(out, i == 0 ? "%zu" : " %zu", text->line_widths[i]);
+    }
+    fprintf(out, "\n");
+    for (size_t i = 0; i < text->linecount; i++) {
+        fprintf(out, i == 0 ? "%zu" : " %zu", text->line_ends[i]);
+    }
+    fprintf(out, "\n");
+}
+
+// false once the client stopped reading. the stream is done then
+static bool flush_response(FILE* out) {
+    if (fflush(out) == EOF || ferror(out)) {
+        SIMPLE_LOG(WARNING, "failed to write response. closing the stream");
+        return false;
+    }
+    return true;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec duration = {.tv_sec = ms / 1000, .tv_nsec = ms % 1000 * 1000000};
+    nanosleep(&duration, NULL);
+}
+
+static void print_stats(const ServerStats* stats, double elapsed_us) {
+    if (stats->requests == 0) {
+        fprintf(stderr, "requests: 0\n");
+        return;
+    }
+    fprintf(stderr, "requests: %zu codepoints: %zu columns: %zu\n", stats->requests, stats->codepoints,
+            stats->columns);
+    fprintf(stderr, "latency(us): min %.2f mean %.2f max %.2f\n", stats->min_us, stats->total_us / stats->requests,
+            stats->max_us);
+    fprintf(stderr, "throughput: %.1f requests/s %.1f codepoints/s (render only), %.1f requests/s (wall)\n",
+            stats->requests / (stats->total_us / 1e6), stats->codepoints / (stats->total_us / 1e6),
+            stats->requests / (elapsed_us / 1e6));
+}
+
+int serve_stream(LoadedFont* font, FILE* in, FILE* out, const ServerOptions* options) {
+    signal(SIGPIPE, SIG_IGN);  // a client closing early must end its stream, not the server
+    ServerStats stats = {.min_us = -1};
+    Arena arena;  // buffers of one request. remapped only when a request is longer than any before
+    arena_init(&arena, 0);
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    double started = now_seconds() * 1e6;
+    while ((len = getline(&line, &capacity, in)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        size_t request_len = unescape_request(line, len);
+
+        double begin = now_seconds() * 1e6;
+        arena_reset(&arena);
+        if (not arena_reserve(&arena, arena_size_of(sizeof(char32_t) * (request_len + 1)) +
+                                          font_render_arena_size(font, request_len + 1, 1))) {
+            fprintf(out, "ERR out of memory\n");
+            if (not flush_response(out)) {
+                break;
+            }
+            continue;
+        }
+        char32_t* utf32_chars = arena_alloc(&arena, sizeof(char32_t) * (request_len + 1));
+        size_t written;
+        size_t error_offset;
+        if (not utf8_transcode(line, request_len, utf32_chars, &written, &error_offset)) {
+            fprintf(out, "ERR invalid utf8 at byte %zu\n", error_offset);
+            if (not flush_response(out)) {
+                break;
+            }
+            continue;
+        }
+        utf32_chars[written] = '\0';
+        size_t utf32_strlen = written + 1;
+        RenderedText text;
+        font_render(font, utf32_chars, utf32_strlen, &arena, &text);
+        write_response(out, &text);
+        if (not flush_response(out)) {
+            break;
+        }
+        double latency = now_seconds() * 1e6 - begin;
+
+        stats.requests++;
+        stats.codepoints += utf32_strlen - 1;
+        stats.columns += text.bitmap_len;
+        stats.total_us += latency;
+        if (stats.min_us < 0 || latency < stats.min_us) {
+            stats.min_us = latency;
+        }
+        if (latency > stats.max_us) {
+            stats.max_us = latency;
+        }
+    }
+    free(line);
+    if (options->show_stats) {
+        print_stats(&stats, now_seconds() * 1e6 - started);
+        report_arena(stderr, "request", &arena);
+    }
+    arena_free(&arena);
+    return 0;
+}
+
+int serve_unix_socket(LoadedFont* font, const char* path, const ServerOptions* options) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        SIMPLE_LOG(FATAL, "socket path is too long");
+        return 1;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd == -1) {
+        SIMPLE_LOG(FATAL, "failed to create socket");
+        return 1;
+    }
+    unlink(path);
+    if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(server_fd, 8) == -1) {
+        SIMPLE_LOG(FATAL, "failed to listen on %s", path);
+        close(server_fd);
+        return 1;
+    }
+    SIMPLE_LOG(INFO, "listening on %s", path);
+    long backoff_ms = 0;
+    while (true) {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            } else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // out of resources until a client or another process releases some. don't spin meanwhile
+                backoff_ms = backoff_ms == 0 ? ACCEPT_BACKOFF_MIN_MS : backoff_ms * 2;
+                if (backoff_ms > ACCEPT_BACKOFF_MAX_MS) {
+                    backoff_ms = ACCEPT_BACKOFF_MAX_MS;
+                }
+                SIMPLE_LOG(ERROR, "failed to accept connection: %s. retrying in %ld ms", strerror(errno), backoff_ms);
+                sleep_ms(backoff_ms);
+                continue;
+            }
+            SIMPLE_LOG(FATAL, "failed to accept connection: %s", strerror(errno));
+            break;
+        }
+        backoff_ms = 0;
+        FILE* in = fdopen(client_fd, "r");
+        FILE* out = fdopen(dup(client_fd), "w");
+        if (in == NULL || out == NULL) {
+            SIMPLE_LOG(ERROR, "failed to open client stream");
+        } else {
+            serve_stream(font, in, out, options);
+        }
+        if (in) {
+            fclose(in);
+        } else {
+            close(client_fd);
+        }
+        if (out) {
+            fclose(out);
+        }
+    }
+    close(server_fd);
+    unlink(path);
+    return 1;
+}
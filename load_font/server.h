@@ -0,0 +1,35 @@
+#ifndef LOAD_FONT_SERVER
+#define LOAD_FONT_SERVER
+#include <stdio.h>
+
+#include "font.h"
+
+/*
+ * line framed protocol
+ * request:  one line of utf8 text. "\n" and "\\" in the line are unescaped into newline and backslash
+ * response: "OK <bitmap_len> <linecount>" followed by three lines,
+ *           which are space separated hex columns of bitmap, line widths and line ends.
+ *           "ERR invalid utf8 at byte <offset>" if the unescaped request is not valid utf8
+ *           "ERR out of memory" if buffers for the request could not be reserved
+ */
+
+typedef struct {
+    bool show_stats;  // print latency and throughput to stderr when a stream is closed
+} ServerOptions;
+
+/**
+ * @brief serve render requests until in reaches EOF or out can't be written
+ *
+ * @return 0 on success
+ *
+ * @note SIGPIPE is ignored from the first call on, so a client closing early ends only its own stream
+ */
+int serve_stream(LoadedFont* font, FILE* in, FILE* out, const ServerOptions* options);
+
+/**
+ * @brief serve render requests on unix domain socket. clients are served one by one
+ *
+ * @return only returns on failure. accept is retried with backoff while file descriptors are exhausted
+ */
+int serve_unix_socket(LoadedFont* font, const char* path, const ServerOptions* options);
+#endif
@@ -0,0 +1,373 @@
+#include "subset.h"
+
+#include <inttypes.h>
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timing.h"
+
+#define SUBSET_PREFIX "subset_font"
+
+static int compare_codepoint(const void* lhs, const void* rhs) {
+    char32_t a = *(const char32_t*)lhs;
+    char32_t b = *(const char32_t*)rhs;
+    return (a > b) - (a < b);
+}
+
+static uint32_t hash_glyph(const uint8_t* bitmap, size_t bytes, uint16_t width) {
+    uint32_t hash = 2'166'136'261u;  // FNV-1a
+    for (size_t i = 0; i < bytes; i++) {
+        hash = (hash ^ bitmap[i]) * 16'777'619u;
+    }
+    return hash ^ width;
+}
+
+bool build_subset(const LoadedFont* font, const char32_t* utf32_chars, SubsetFont* subset) {
+    memset(subset, 0, sizeof(SubsetFont));
+    subset->column_size = font->column_size;
+    subset->max_width = font->max_width;
+    subset->height = font->height;
+
+    size_t textlen = 0;
+    while (utf32_chars[textlen] != '\0') {
+        textlen++;
+    }
+    char32_t* codepoints = malloc(sizeof(char32_t) * (textlen + 1));
+    size_t unique_count = 0;
+    for (size_t i = 0; i < textlen; i++) {
+        if (utf32_chars[i] != '\n') {
+            codepoints[unique_count++] = utf32_chars[i];
+        }
+    }
+    qsort(codepoints, unique_count, sizeof(char32_t), compare_codepoint);
+
+    subset->codepoints = malloc(sizeof(char32_t) * (unique_count + 1));
+    subset->glyph_indices = malloc(sizeof(uint16_t) * (unique_count + 1));
+    subset->glyph_offsets = malloc(sizeof(uint32_t) * (unique_count + 1));
+    subset->glyph_offsets[0] = 0;
+    subset->columns = malloc(font->column_size * ((size_t)font->max_width * unique_count + 1));
+    uint8_t* columns = subset->columns;
+
+    // open addressing table of glyph indices keyed by bitmap, for deduplication
+    size_t bucket_count = 2;
+    while (bucket_count < unique_count * 2) {
+        bucket_count *= 2;
+    }
+    uint32_t* buckets = malloc(sizeof(uint32_t) * bucket_count);
+    memset(buckets, 0xff, sizeof(uint32_t) * bucket_count);
+
+    for (size_t i = 0; i < unique_count; i++) {
+        if (i > 0 && codepoints[i] == codepoints[i - 1]) {
+            continue;
+        }
+        uint32_t gid = font_search_char(font, codepoints[i]);
+        if (gid == FONT_GID_NOT_FOUND) {
+            SIMPLE_LOG(ERROR, "character 0x%04x wasn't found", codepoints[i]);
+            continue;
+        }
+        uint16_t width;
+        const uint8_t* bitmap = font_glyph_bitmap(font, gid, &width);
+        if (bitmap == NULL) {
+            SIMPLE_LOG(ERROR, "glyph 0x%04x of character 0x%04x wasn't found", gid, codepoints[i]);
+            continue;
+        }
+        size_t bytes = font->column_size * width;
+        size_t bucket = hash_glyph(bitmap, bytes, width) & (bucket_count - 1);
+        while (buckets[bucket] != UINT32_MAX) {
+            uint32_t candidate = buckets[bucket];
+            uint32_t begin = subset->glyph_offsets[candidate];
+            if (subset->glyph_offsets[candidate + 1] - begin == width &&
+                memcmp(columns + font->column_size * begin, bitmap, bytes) == 0) {
+                break;
+            }
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        if (buckets[bucket] == UINT32_MAX) {
+            buckets[bucket] = subset->glyph_count;
+            memcpy(columns + font->column_size * subset->column_count, bitmap, bytes);
+            subset->column_count += width;
+            subset->glyph_count++;
+            subset->glyph_offsets[subset->glyph_count] = subset->column_count;
+        }
+        subset->codepoints[subset->codepoint_count] = codepoints[i];
+        subset->glyph_indices[subset->codepoint_count] = buckets[bucket];
+        subset->codepoint_count++;
+    }
+    free(buckets);
+    free(codepoints);
+    SIMPLE_LOG(INFO, "subset: %zu codepoints, %zu glyphs, %zu columns", subset->codepoint_count, subset->glyph_count,
+               subset->column_count);
+    if (subset->codepoint_count == 0) {
+        SIMPLE_LOG(FATAL, "no character of the string is in the font");
+        return false;
+    }
+    return true;
+}
+
+void free_subset(SubsetFont* subset) {
+    free(subset->codepoints);
+    free(subset->glyph_indices);
+    free(subset->glyph_offsets);
+    free(subset->columns);
+    memset(subset, 0, sizeof(SubsetFont));
+}
+
+#define COLUMN_T uint8_t
+#define COLUMN_FN(name) name##_8
+#include "subset_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint16_t
+#define COLUMN_FN(name) name##_16
+#include "subset_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint32_t
+#define COLUMN_FN(name) name##_32
+#include "subset_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+#define COLUMN_T uint64_t
+#define COLUMN_FN(name) name##_64
+#include "subset_columns.h"
+#undef COLUMN_T
+#undef COLUMN_FN
+
+size_t subset_search_glyph(const SubsetFont* subset, char32_t ch, void* bitmap_buf) {
+    switch (subset->column_size) {
+        case sizeof(uint8_t):
+            return subset_search_glyph_8(subset, ch, bitmap_buf);
+        case sizeof(uint16_t):
+            return subset_search_glyph_16(subset, ch, bitmap_buf);
+        case sizeof(uint32_t):
+            return subset_search_glyph_32(subset, ch, bitmap_buf);
+        default:
+            return subset_search_glyph_64(subset, ch, bitmap_buf);
+    }
+}
+
+// smallest unsigned integer size which can hold max
+static size_t uint_size(uint32_t max) {
+    if (max <= UINT8_MAX) {
+        return 1;
+    } else if (max <= UINT16_MAX) {
+        return 2;
+    } else {
+        return 4;
+    }
+}
+
+static const char* uint_type(size_t size) {
+    switch (size) {
+        case 1:
+            return "uint8_t";
+        case 2:
+            return "uint16_t";
+        case 4:
+            return "uint32_t";
+        default:
+            return "uint64_t";
+    }
+}
+
+typedef struct {
+    size_t column_size;
+    size_t offset_size;
+    size_t codepoint_size;
+    size_t index_size;
+} SubsetLayout;
+
+static SubsetLayout subset_layout(const SubsetFont* subset) {
+    SubsetLayout layout = {
+        .column_size = subset->column_size,
+        .offset_size = uint_size(subset->column_count),
+        .codepoint_size = uint_size(subset->codepoint_count == 0 ? 0 : subset->codepoints[subset->codepoint_count - 1]),
+        .index_size = uint_size(subset->glyph_count == 0 ? 0 : subset->glyph_count - 1),
+    };
+    return layout;
+}
+
+size_t subset_footprint(const SubsetFont* subset) {
+    SubsetLayout layout = subset_layout(subset);
+    return layout.column_size * subset->column_count + layout.offset_size * (subset->glyph_count + 1) +
+           (layout.codepoint_size + layout.index_size) * subset->codepoint_count;
+}
+
+static void write_array(FILE* outfile, const char* type, const char* name, size_t count, const char* format,
+                        uint64_t (*get)(const SubsetFont*, size_t), const SubsetFont* subset) {
+    fprintf(outfile, "static const %s " SUBSET_PREFIX "_%s[%zu] = {", type, name, count == 0 ? 1 : count);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(outfile, i % 16 == 0 ? "\n    " : " ");
+        fprintf(outfile, format, get(subset, i));
+        fprintf(outfile, ",");
+    }
+    fprintf(outfile, "\n};\n");
+}
+
+static uint64_t get_column(const SubsetFont* subset, size_t i) {
+    switch (subset->column_size) {
+        case sizeof(uint8_t):
+            return subset->columns8[i];
+        case sizeof(uint16_t):
+            return subset->columns16[i];
+        case sizeof(uint32_t):
+            return subset->columns32[i];
+        default:
+            return subset->columns64[i];
+    }
+}
+static uint64_t get_offset(const SubsetFont* subset, size_t i) { return subset->glyph_offsets[i]; }
+static uint64_t get_codepoint(const SubsetFont* subset, size_t i) { return subset->codepoints[i]; }
+static uint64_t get_index(const SubsetFont* subset, size_t i) { return subset->glyph_indices[i]; }
+
+void write_subset_header(FILE* outfile, const SubsetFont* subset, const char* font_name) {
+    SubsetLayout layout = subset_layout(subset);
+    const char* column_type = uint_type(layout.column_size);
+    fprintf(outfile, "// generated by load_font --subset-header from \"%s\"\n", font_name);
+    fprintf(outfile, "// %zu codepoints, %zu glyphs, %zu bytes\n", subset->codepoint_count, subset->glyph_count,
+            subset_footprint(subset));
+    fprintf(outfile, "#ifndef SUBSET_FONT_H\n#define SUBSET_FONT_H\n");
+    fprintf(outfile, "#include <stddef.h>\n#include <stdint.h>\n#include <uchar.h>\n\n");
+    fprintf(outfile, "#define SUBSET_FONT_HEIGHT %u\n", subset->height);
+    fprintf(outfile, "#define SUBSET_FONT_MAX_COLUMNS %u  // widest glyph and blank columns around it\n",
+            subset->max_width + 2);
+    fprintf(outfile, "#define SUBSET_FONT_CODEPOINT_COUNT %zu\n\n", subset->codepoint_count);
+
+    write_array(outfile, column_type, "columns", subset->column_count, "0x%" PRIX64, get_column, subset);
+    fprintf(outfile, "// columns of glyph i are [glyph_offsets[i], glyph_offsets[i + 1])\n");
+    write_array(outfile, uint_type(layout.offset_size), "glyph_offsets", subset->glyph_count + 1, "%" PRIu64,
+                get_offset, subset);
+    fprintf(outfile, "// sorted\n");
+    write_array(outfile, uint_type(layout.codepoint_size), "codepoints", subset->codepoint_count, "0x%" PRIX64,
+                get_codepoint, subset);
+    write_array(outfile, uint_type(layout.index_size), "glyph_indices", subset->codepoint_count, "%" PRIu64, get_index,
+                subset);
+
+    fprintf(outfile,
+            "\n"
+            "// writes glyph of ch with blank column around it into out, which needs SUBSET_FONT_MAX_COLUMNS columns.\n"
+            "// returns the number of columns written, or 0 if ch is not in the subset\n"
+            "static inline size_t " SUBSET_PREFIX "_search_glyph(char32_t ch, %s* out) {\n"
+            "    size_t range_min = 0;\n"
+            "    size_t range_max = SUBSET_FONT_CODEPOINT_COUNT;\n"
+            "    while (range_min < range_max) {\n"
+            "        size_t pivot = range_min + (range_max - range_min) / 2;\n"
+            "        if (" SUBSET_PREFIX "_codepoints[pivot] == ch) {\n"
+            "            size_t glyph = " SUBSET_PREFIX "_glyph_indices[pivot];\n"
+            "            size_t begin = " SUBSET_PREFIX "_glyph_offsets[glyph];\n"
+            "            size_t end = " SUBSET_PREFIX "_glyph_offsets[glyph + 1];\n"
+            "            size_t result = 0;\n"
+            "            if (begin != end && " SUBSET_PREFIX "_columns[begin] != 0) {\n"
+            "                out[result++] = 0;\n"
+            "            }\n"
+            "            for (size_t i = begin; i < end; i++) {\n"
+            "                out[result++] = " SUBSET_PREFIX "_columns[i];\n"
+            "            }\n"
+            "            if (begin != end && " SUBSET_PREFIX "_columns[end - 1] != 0) {\n"
+            "                out[result++] = 0;\n"
+            "            }\n"
+            "            return result;\n"
+            "        } else if (" SUBSET_PREFIX "_codepoints[pivot] < ch) {\n"
+            "            range_min = pivot + 1;\n"
+            "        } else {\n"
+            "            range_max = pivot;\n"
+            "        }\n"
+            "    }\n"
+            "    return 0;\n"
+            "}\n"
+            "\n"
+            "// renders len codepoints of text into out. characters not in the subset, including '\\n', are skipped.\n"
+            "// stops when less than SUBSET_FONT_MAX_COLUMNS columns are left. returns the number of columns written\n"
+            "static inline size_t " SUBSET_PREFIX
+            "_render(const char32_t* text, size_t len, %s* out, size_t capacity) {\n"
+            "    size_t written = 0;\n"
+            "    for (size_t i = 0; i < len && capacity - written >= SUBSET_FONT_MAX_COLUMNS; i++) {\n"
+            "        written += " SUBSET_PREFIX "_search_glyph(text[i], out + written);\n"
+            "    }\n"
+            "    return written;\n"
+            "}\n"
+            "#endif\n",
+            column_type, column_type);
+}
+
+typedef struct {
+    const LoadedFont* font;
+    const SubsetFont* subset;
+    const char32_t* text;
+    size_t textlen;
+    void* bitmap;
+} RenderBench;
+
+static void render_subset(void* context) {
+    RenderBench* bench = context;
+    size_t column_size = bench->subset->column_size;
+    size_t written = 0;
+    for (size_t i = 0; i < bench->textlen; i++) {
+        written += subset_search_glyph(bench->subset, bench->text[i], (uint8_t*)bench->bitmap + column_size * written);
+    }
+}
+
+static void render_font(void* context) {
+    RenderBench* bench = context;
+    size_t column_size = bench->font->column_size;
+    size_t written = 0;
+    for (size_t i = 0; i < bench->textlen; i++) {
+        uint32_t gid = font_search_char(bench->font, bench->text[i]);
+        written += font_search_glyph(bench->font, gid, (uint8_t*)bench->bitmap + column_size * written);
+    }
+}
+
+void report_subset(FILE* out, const LoadedFont* font, const SubsetFont* subset, const char32_t* utf32_chars,
+                   size_t utf32_strlen) {
+    size_t font_cmap_bytes = 0;
+    for (size_t i = 0; i < CMAP_TABLE_COUNT; i++) {
+        font_cmap_bytes += font->cmaps[i].itemsize * font->cmaps[i].itemcount;
+    }
+    font_cmap_bytes += CMAP_RANGE_SIZE * font->cmap_ranges.count;
+    size_t font_glyph_bytes = 0;
+    for (size_t i = 0; i < font->glyph_range_count; i++) {
+        GlyphRange range;
+        if (font_glyph_range(font, i, &range)) {
+            font_glyph_bytes +=
+                sizeof(uint16_t) * 3 + font->column_size * range.width * (range.last_gid - range.first_gid + 1);
+        }
+    }
+    size_t subset_bytes = subset_footprint(subset);
+    size_t font_bytes = font_cmap_bytes + font_glyph_bytes;
+    fprintf(out, "subset: %zu codepoints, %zu glyphs (%zu merged as duplicates)\n", subset->codepoint_count,
+            subset->glyph_count, subset->codepoint_count - subset->glyph_count);
+    fprintf(out, "flash footprint: subset %zu bytes, full font %zu bytes (cmap %zu, glyphs %zu), %.2f%%\n",
+            subset_bytes, font_bytes, font_cmap_bytes, font_glyph_bytes, 100.0 * subset_bytes / font_bytes);
+
+    // render characters which are in the subset, so that both sides do the same work
+    char32_t* text = malloc(sizeof(char32_t) * utf32_strlen);
+    void* column_buf = malloc(font->column_size * (subset->max_width + 2));
+    size_t textlen = 0;
+    size_t columns = 0;
+    for (size_t i = 0; utf32_chars[i] != '\0'; i++) {
+        size_t width = subset_search_glyph(subset, utf32_chars[i], column_buf);
+        if (width != 0) {
+            text[textlen++] = utf32_chars[i];
+            columns += width;
+        }
+    }
+    void* subset_bitmap = malloc(font->column_size * (columns + 1));
+    void* font_bitmap = malloc(font->column_size * (columns + 1));
+
+    size_t char_count = textlen == 0 ? 1 : textlen;
+    RenderBench bench = {.font = font, .subset = subset, .text = text, .textlen = textlen, .bitmap = subset_bitmap};
+    double subset_ns = seconds_per_run(render_subset, &bench, TIMING_MIN_SECONDS) * 1e9 / char_count;
+    bench.bitmap = font_bitmap;
+    double font_ns = seconds_per_run(render_font, &bench, TIMING_MIN_SECONDS) * 1e9 / char_count;
+
+    fprintf(out, "host render: subset %.1f ns/char, full font %.1f ns/char (%zu chars)\n", subset_ns, font_ns,
+            textlen);
+    fprintf(out, "output matches full font: %s\n",
+            memcmp(subset_bitmap, font_bitmap, font->column_size * columns) == 0 ? "yes" : "NO");
+    free(column_buf);
+    free(font_bitmap);
+    free(subset_bitmap);
+    free(text);
+}
@@ -0,0 +1,54 @@
+#ifndef LOAD_FONT_SUBSET
+#define LOAD_FONT_SUBSET
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <uchar.h>
+
+#include "font.h"
+
+/*
+ * glyphs used by a text, packed for devices which can't hold the whole font.
+ * identical glyph bitmaps are stored once, and the cmap is a sorted codepoint array
+ * with a parallel array of glyph indices
+ */
+typedef struct {
+    size_t codepoint_count;
+    char32_t* codepoints;     // sorted
+    uint16_t* glyph_indices;  // parallel to codepoints
+    size_t glyph_count;
+    uint32_t* glyph_offsets;  // glyph_count + 1 items. columns of glyph i are [offsets[i], offsets[i + 1])
+    size_t column_count;
+    union {
+        void* columns;  // column_size bytes each, as in the font
+        uint8_t* columns8;
+        uint16_t* columns16;
+        uint32_t* columns32;
+        uint64_t* columns64;
+    };
+    size_t column_size;
+    uint16_t max_width;
+    uint16_t height;
+} SubsetFont;
+
+/**
+ * @brief collect glyphs used in utf32_chars
+ *
+ * @return false if none of the characters are in the font
+ */
+bool build_subset(const LoadedFont* font, const char32_t* utf32_chars, SubsetFont* subset);
+void free_subset(SubsetFont* subset);
+
+// same as font_search_glyph, but looks up the subset. returns 0 if ch is not in the subset
+size_t subset_search_glyph(const SubsetFont* subset, char32_t ch, void* bitmap_buf);
+
+// bytes the subset takes in flash when written with write_subset_header
+size_t subset_footprint(const SubsetFont* subset);
+
+// emit C header with the subset tables and an allocation-free renderer
+void write_subset_header(FILE* outfile, const SubsetFont* subset, const char* font_name);
+
+// print footprint and host render speed of the subset against the full font
+void report_subset(FILE* out, const LoadedFont* font, const SubsetFont* subset, const char32_t* utf32_chars,
+                   size_t utf32_strlen);
+#endif
@@ -0,0 +1,36 @@
+/*
+ * subset glyph copy for one column type.
+ * subset.c includes this once per column type with these defined, so there is no include guard:
+ *   COLUMN_T         uint8_t, uint16_t, uint32_t or uint64_t
+ *   COLUMN_FN(name)  name suffixed with the column width
+ */
+
+static size_t COLUMN_FN(subset_search_glyph)(const SubsetFont* subset, char32_t ch, COLUMN_T* bitmap_buf) {
+    const COLUMN_T* columns = subset->columns;
+    size_t range_min = 0;
+    size_t range_max = subset->codepoint_count;
+    while (range_min < range_max) {
+        size_t pivot = range_min + (range_max - range_min) / 2;
+        if (subset->codepoints[pivot] == ch) {
+            size_t glyph = subset->glyph_indices[pivot];
+            size_t begin = subset->glyph_offsets[glyph];
+            size_t end = subset->glyph_offsets[glyph + 1];
+            size_t result = 0;
+            if (begin != end && columns[begin] != 0) {
+                bitmap_buf[result++] = 0;
+            }
+            for (size_t i = begin; i < end; i++) {
+                bitmap_buf[result++] = columns[i];
+            }
+            if (begin != end && columns[end - 1] != 0) {
+                bitmap_buf[result++] = 0;
+            }
+            return result;
+        } else if (subset->codepoints[pivot] < ch) {
+            range_min = pivot + 1;
+        } else {
+            range_max = pivot;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include "timing.h"
+
+#include <stddef.h>
+#include <time.h>
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double seconds_per_run(TimedBody body, void* context, double min_seconds) {
+    size_t runs = 0;
+    double begin = now_seconds();
+    double elapsed;
+    do {
+        body(context);
+        runs++;
+        elapsed = now_seconds() - begin;
+    } while (elapsed < min_seconds);
+    return elapsed / runs;
+}
@@ -0,0 +1,18 @@
+#ifndef LOAD_FONT_TIMING
+#define LOAD_FONT_TIMING
+
+// how long the --*-stats reports run each measurement
+#define TIMING_MIN_SECONDS 0.1
+
+// monotonic clock
+double now_seconds(void);
+
+typedef void (*TimedBody)(void* context);
+
+/**
+ * @brief run body repeatedly for at least min_seconds
+ *
+ * @return seconds per run. body runs once if min_seconds is 0
+ */
+double seconds_per_run(TimedBody body, void* context, double min_seconds);
+#endif
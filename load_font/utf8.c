@@ -0,0 +1,481 @@
+#include "utf8.h"
+
+#include <iso646.h>
+#include <simple_logging.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define UTF8_X86_KERNELS
+#endif
+
+#include "timing.h"
+
+// taken from my mod on cmatrix
+#define c_die(msg)              \
+    do {                        \
+        SIMPLE_LOG(FATAL, msg); \
+        return -1;              \
+    } while (false)
+
+char32_t cstr_to_codepoint_utf8(const char* cstr, size_t* n_used_cstr) {
+    uint32_t result = 0;
+    size_t n = 1;
+    if (cstr[0] == '\0') {
+        result = '\0';
+        n = 0;
+    } else if ((*cstr & 0x80) == 0) {
+        result = *cstr;
+        n = 1;
+    } else if ((*cstr & 0xe0) == 0xc0) {
+        result |= (*cstr & 0x1f) << 6;
+        cstr++;
+        n++;
+        if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
+        result |= (*cstr & 0x3f);
+        if (result < 0x0080) c_die("Invalid utf8 sequence");
+    } else if ((*cstr & 0xf0) == 0xe0) {
+        result |= (*cstr & 0x0f) << 12;
+        for (int i = 2; i > 0; i--) {
+            cstr++;
+            n++;
+            if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
+            result |= (*cstr & 0x3f) << (6 * (i - 1));
+        }
+        if (result < 0x0800) c_die("Invalid utf8 sequence");
+        if (result >= 0xd800 && result <= 0xdfff) c_die("Invalid utf8 sequence");  // surrogates
+    } else if ((*cstr & 0xf8) == 0xf0) {
+        result |= (*cstr & 0x07) << 18;
+        for (int i = 3; i > 0; i--) {
+            cstr++;
+            n++;
+            if ((*cstr & 0xc0) != 0x80) c_die("Invalid utf8 sequence");
+            result |= (*cstr & 0x3f) << (6 * (i - 1));
+        }
+        if (result < 0x10000) c_die("Invalid utf8 sequence");
+    } else {
+        c_die("Invalid utf8 sequence");
+    }
+    if (result > 0x10ffff) {
+        c_die("Invalid utf8 sequence");
+    }
+    if (n_used_cstr != NULL) {
+        *n_used_cstr = n;
+    }
+    return result;
+}
+
+char32_t cstr_to_codepoint_native(const char* cstr, size_t* n_used_cstr) {
+    // some environment specific things will be here
+    return cstr_to_codepoint_utf8(cstr, n_used_cstr);
+}
+
+// decode one multibyte sequence. returns bytes used, or 0 if the sequence is invalid or truncated
+static size_t decode_sequence(const uint8_t* src, size_t len, char32_t* out) {
+    uint8_t lead = src[0];
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        if (len < 2 || (src[1] & 0xc0) != 0x80) {
+            return 0;
+        }
+        *out = ((lead & 0x1f) << 6) | (src[1] & 0x3f);
+        return 2;
+    }
+    if (lead >= 0xe0 && lead <= 0xef) {
+        if (len < 3 || (src[1] & 0xc0) != 0x80 || (src[2] & 0xc0) != 0x80) {
+            return 0;
+        }
+        char32_t codepoint = ((lead & 0x0f) << 12) | ((src[1] & 0x3f) << 6) | (src[2] & 0x3f);
+        if (codepoint < 0x0800 || (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+            return 0;
+        }
+        *out = codepoint;
+        return 3;
+    }
+    if (lead >= 0xf0 && lead <= 0xf4) {
+        if (len < 4 || (src[1] & 0xc0) != 0x80 || (src[2] & 0xc0) != 0x80 || (src[3] & 0xc0) != 0x80) {
+            return 0;
+        }
+        char32_t codepoint =
+            ((lead & 0x07) << 18) | ((src[1] & 0x3f) << 12) | ((src[2] & 0x3f) << 6) | (src[3] & 0x3f);
+        if (codepoint < 0x10000 || codepoint > 0x10ffff) {
+            return 0;
+        }
+        *out = codepoint;
+        return 4;
+    }
+    return 0;  // continuation byte, overlong lead 0xc0/0xc1 or lead beyond U+10FFFF
+}
+
+/*
+ * ascii kernels widen the leading ascii bytes of src into out and return how many they converted.
+ * multibyte kernels convert the leading run of two byte, or of three byte sequences, a whole vector at a time.
+ * a vector is converted only if every sequence in it is valid, so the sequence that fails is left to
+ * decode_sequence, which reports it. they return the number of sequences converted.
+ * everything else goes through decode_sequence, so kernels only differ in speed
+ */
+typedef size_t (*ASCIIKernel)(const uint8_t* src, size_t len, char32_t* out);
+typedef size_t (*MultibyteKernel)(const uint8_t* src, size_t len, char32_t* out);
+
+typedef struct {
+    ASCIIKernel ascii_run;
+    MultibyteKernel two_byte_run;    // NULL if two byte sequences are decoded one by one
+    MultibyteKernel three_byte_run;  // NULL if three byte sequences are decoded one by one
+} KernelSet;
+
+static size_t ascii_run_scalar(const uint8_t* src, size_t len, char32_t* out) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, src + i, sizeof(word));
+        if ((word & 0x8080808080808080) != 0) {
+            break;
+        }
+        for (size_t j = 0; j < 8; j++) {
+            out[i + j] = src[i + j];
+        }
+    }
+    for (; i < len && src[i] < 0x80; i++) {
+        out[i] = src[i];
+    }
+    return i;
+}
+
+#ifdef UTF8_X86_KERNELS
+__attribute__((target("sse2"))) static size_t ascii_run_sse2(const uint8_t* src, size_t len, char32_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(high, zero));
+    }
+    return i + ascii_run_scalar(src + i, len - i, out + i);
+}
+
+/*
+ * two byte sequences of a run start at even offsets, so each 16 bit lane holds one, lead in the low byte.
+ * valid if the lead is 110xxxxx, the other 10xxxxxx and the codepoint is not overlong (lead 0xc0, 0xc1)
+ */
+__attribute__((target("sse2"))) static size_t two_byte_run_sse2(const uint8_t* src, size_t len, char32_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    for (; 2 * count + 16 <= len; count += 8) {
+        __m128i lanes = _mm_loadu_si128((const __m128i*)(src + 2 * count));
+        __m128i form = _mm_cmpeq_epi16(_mm_and_si128(lanes, _mm_set1_epi16((short)0xc0e0)),
+                                       _mm_set1_epi16((short)0x80c0));
+        __m128i codepoints = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(lanes, _mm_set1_epi16(0x1f)), 6),
+                                          _mm_and_si128(_mm_srli_epi16(lanes, 8), _mm_set1_epi16(0x3f)));
+        __m128i shortest = _mm_cmpgt_epi16(codepoints, _mm_set1_epi16(0x7f));
+        if (_mm_movemask_epi8(_mm_and_si128(form, shortest)) != 0xffff) {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(out + count), _mm_unpacklo_epi16(codepoints, zero));
+        _mm_storeu_si128((__m128i*)(out + count + 4), _mm_unpackhi_epi16(codepoints, zero));
+    }
+    return count;
+}
+
+/*
+ * three byte sequences are shuffled into 32 bit lanes, lead in the low byte.
+ * valid if the lead is 1110xxxx, the others 10xxxxxx, and the codepoint is neither overlong nor a surrogate
+ */
+__attribute__((target("ssse3"))) static size_t three_byte_run_ssse3(const uint8_t* src, size_t len,
+                                                                   char32_t* out) {
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t count = 0;
+    for (; 3 * count + 16 <= len; count += 4) {
+        __m128i lanes = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 3 * count)), spread);
+        __m128i form = _mm_cmpeq_epi32(_mm_and_si128(lanes, _mm_set1_epi32(0xc0c0f0)), _mm_set1_epi32(0x8080e0));
+        __m128i codepoints = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(lanes, _mm_set1_epi32(0x0f)), 12),
+                         _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0xfc0))),
+            _mm_and_si128(_mm_srli_epi32(lanes, 16), _mm_set1_epi32(0x3f)));
+        __m128i shortest = _mm_cmpgt_epi32(codepoints, _mm_set1_epi32(0x7ff));
+        __m128i surrogate = _mm_cmpeq_epi32(_mm_and_si128(codepoints, _mm_set1_epi32(0xf800)), _mm_set1_epi32(0xd800));
+        if (_mm_movemask_epi8(_mm_andnot_si128(surrogate, _mm_and_si128(form, shortest))) != 0xffff) {
+            break;
+        }
+        _mm_storeu_si128((__m128i*)(out + count), codepoints);
+    }
+    return count;
+}
+
+__attribute__((target("avx2"))) static size_t ascii_run_avx2(const uint8_t* src, size_t len, char32_t* out) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(src + i));
+        if (_mm256_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        for (size_t j = 0; j < 32; j += 8) {
+            __m256i wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i + j)));
+            _mm256_storeu_si256((__m256i*)(out + i + j), wide);
+        }
+    }
+    // gcc doesn't insert vzeroupper in target("avx2") functions. without it, the sse code run after them,
+    // including the tails below, stalls on the dirty upper halves
+    _mm256_zeroupper();
+    return i + ascii_run_scalar(src + i, len - i, out + i);
+}
+
+// same checks as two_byte_run_sse2
+__attribute__((target("avx2"))) static size_t two_byte_run_avx2(const uint8_t* src, size_t len, char32_t* out) {
+    size_t count = 0;
+    // a vector whose last byte is ascii would fail. the 16 byte vectors below may still fit
+    for (; 2 * count + 32 <= len && src[2 * count + 31] >= 0x80; count += 16) {
+        __m256i lanes = _mm256_loadu_si256((const __m256i*)(src + 2 * count));
+        __m256i form = _mm256_cmpeq_epi16(_mm256_and_si256(lanes, _mm256_set1_epi16((short)0xc0e0)),
+                                          _mm256_set1_epi16((short)0x80c0));
+        __m256i codepoints = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(lanes, _mm256_set1_epi16(0x1f)), 6),
+                                             _mm256_and_si256(_mm256_srli_epi16(lanes, 8), _mm256_set1_epi16(0x3f)));
+        __m256i shortest = _mm256_cmpgt_epi16(codepoints, _mm256_set1_epi16(0x7f));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_and_si256(form, shortest)) != UINT32_MAX) {
+            break;
+        }
+        __m128i low = _mm256_castsi256_si128(codepoints);
+        __m128i high = _mm256_extracti128_si256(codepoints, 1);
+        _mm256_storeu_si256((__m256i*)(out + count), _mm256_cvtepu16_epi32(low));
+        _mm256_storeu_si256((__m256i*)(out + count + 8), _mm256_cvtepu16_epi32(high));
+    }
+    _mm256_zeroupper();
+    return count + two_byte_run_sse2(src + 2 * count, len - 2 * count, out + count);
+}
+
+// same checks as three_byte_run_ssse3. each 128 bit half takes 12 bytes, since shuffles don't cross halves
+__attribute__((target("avx2"))) static size_t three_byte_run_avx2(const uint8_t* src, size_t len, char32_t* out) {
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+                                            5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    size_t count = 0;
+    for (; 3 * count + 12 + 16 <= len && src[3 * count + 23] >= 0x80; count += 8) {
+        const uint8_t* block = src + 3 * count;
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)block)),
+                                                _mm_loadu_si128((const __m128i*)(block + 12)), 1);
+        __m256i lanes = _mm256_shuffle_epi8(bytes, spread);
+        __m256i form =
+            _mm256_cmpeq_epi32(_mm256_and_si256(lanes, _mm256_set1_epi32(0xc0c0f0)), _mm256_set1_epi32(0x8080e0));
+        __m256i codepoints = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(lanes, _mm256_set1_epi32(0x0f)), 12),
+                            _mm256_and_si256(_mm256_srli_epi32(lanes, 2), _mm256_set1_epi32(0xfc0))),
+            _mm256_and_si256(_mm256_srli_epi32(lanes, 16), _mm256_set1_epi32(0x3f)));
+        __m256i shortest = _mm256_cmpgt_epi32(codepoints, _mm256_set1_epi32(0x7ff));
+        __m256i surrogate =
+            _mm256_cmpeq_epi32(_mm256_and_si256(codepoints, _mm256_set1_epi32(0xf800)), _mm256_set1_epi32(0xd800));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(surrogate, _mm256_and_si256(form, shortest))) !=
+            UINT32_MAX) {
+            break;
+        }
+        _mm256_storeu_si256((__m256i*)(out + count), codepoints);
+    }
+    _mm256_zeroupper();
+    return count + three_byte_run_ssse3(src + 3 * count, len - 3 * count, out + count);
+}
+#endif
+
+static KernelSet kernel_set(UTF8Kernel kernel) {
+    switch (kernel) {
+#ifdef UTF8_X86_KERNELS
+        case UTF8_SSE2_KERNEL:
+            return (KernelSet){ascii_run_sse2, two_byte_run_sse2, NULL};
+        case UTF8_SSSE3_KERNEL:
+            return (KernelSet){ascii_run_sse2, two_byte_run_sse2, three_byte_run_ssse3};
+        case UTF8_AVX2_KERNEL:
+            return (KernelSet){ascii_run_avx2, two_byte_run_avx2, three_byte_run_avx2};
+#endif
+        default:
+            return (KernelSet){ascii_run_scalar, NULL, NULL};
+    }
+}
+
+bool utf8_kernel_supported(UTF8Kernel kernel) {
+    switch (kernel) {
+        case UTF8_SCALAR_KERNEL:
+            return true;
+#ifdef UTF8_X86_KERNELS
+        case UTF8_SSE2_KERNEL:
+            return __builtin_cpu_supports("sse2");
+        case UTF8_SSSE3_KERNEL:
+            return __builtin_cpu_supports("ssse3");
+        case UTF8_AVX2_KERNEL:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* utf8_kernel_name(UTF8Kernel kernel) {
+    static const char* names[UTF8_KERNEL_COUNT] = {"scalar", "sse2", "ssse3", "avx2"};
+    return kernel < UTF8_KERNEL_COUNT ? names[kernel] : "unknown";
+}
+
+UTF8Kernel utf8_best_kernel(void) {
+    for (UTF8Kernel kernel = UTF8_KERNEL_COUNT - 1; kernel > UTF8_SCALAR_KERNEL; kernel--) {
+        if (utf8_kernel_supported(kernel)) {
+            return kernel;
+        }
+    }
+    return UTF8_SCALAR_KERNEL;
+}
+
+bool utf8_transcode_with(UTF8Kernel kernel, const char* src, size_t len, char32_t* out, size_t* written,
+                         size_t* error_offset) {
+    KernelSet kernels = kernel_set(kernel);
+    const uint8_t* bytes = (const uint8_t*)src;
+    size_t pos = 0;
+    size_t count = 0;
+    bool valid = true;
+    while (valid && pos < len) {
+        if (bytes[pos] < 0x80) {
+            // a lone ascii byte between multibyte sequences isn't worth a kernel call
+            if (pos + 1 == len || bytes[pos + 1] >= 0x80) {
+                out[count++] = bytes[pos++];
+                continue;
+            }
+            size_t ascii_count = kernels.ascii_run(bytes + pos, len - pos, out + count);
+            pos += ascii_count;
+            count += ascii_count;
+            continue;
+        }
+        // vectors are tried once at the start of a multibyte run. the smallest take 16 bytes of two byte or 12 of
+        // three byte sequences, and fail if their last byte is ascii, as for most words shorter than a vector
+        if (len - pos >= 16) {
+            if (bytes[pos] < 0xe0 && bytes[pos + 15] >= 0x80 && kernels.two_byte_run != NULL) {
+                size_t converted = kernels.two_byte_run(bytes + pos, len - pos, out + count);
+                pos += 2 * converted;
+                count += converted;
+            } else if (bytes[pos] >= 0xe0 && bytes[pos] < 0xf0 && bytes[pos + 11] >= 0x80 &&
+                       kernels.three_byte_run != NULL) {
+                size_t converted = kernels.three_byte_run(bytes + pos, len - pos, out + count);
+                pos += 3 * converted;
+                count += converted;
+            }
+        }
+        // rest of the run, one by one
+        while (pos < len && bytes[pos] >= 0x80) {
+            size_t used = decode_sequence(bytes + pos, len - pos, out + count);
+            if (used == 0) {
+                valid = false;
+                break;
+            }
+            pos += used;
+            count++;
+        }
+    }
+    *written = count;
+    if (not valid && error_offset != NULL) {
+        *error_offset = pos;
+    }
+    return valid;
+}
+
+bool utf8_transcode(const char* src, size_t len, char32_t* out, size_t* written, size_t* error_offset) {
+    return utf8_transcode_with(utf8_best_kernel(), src, len, out, written, error_offset);
+}
+
+bool utf8_transcode_reference(const char* src, size_t len, char32_t* out, size_t* written, size_t* error_offset) {
+    size_t pos = 0;
+    size_t count = 0;
+    while (pos < len) {
+        size_t used;
+        char32_t codepoint = cstr_to_codepoint_utf8(src + pos, &used);
+        if (codepoint == (char32_t)-1) {
+            *written = count;
+            if (error_offset != NULL) {
+                *error_offset = pos;
+            }
+            return false;
+        }
+        out[count++] = codepoint;
+        pos += used == 0 ? 1 : used;  // NUL uses no bytes for cstr_to_codepoint_utf8, but is a codepoint here
+    }
+    *written = count;
+    return true;
+}
+
+char32_t* cstr_to_utf32(const char* cstr, size_t* utf32_strlen, Arena* arena) {
+    size_t len = strlen(cstr);
+    char32_t* utf32_chars = arena_alloc(arena, sizeof(char32_t) * (len + 1));
+    size_t written;
+    size_t error_offset;
+    if (not utf8_transcode(cstr, len, utf32_chars, &written, &error_offset)) {
+        SIMPLE_LOG(ERROR, "invalid utf8 sequence at byte %zu", error_offset);
+        return NULL;
+    }
+    utf32_chars[written] = '\0';
+    if (utf32_strlen != NULL) {
+        *utf32_strlen = written + 1;
+    }
+    return utf32_chars;
+}
+
+typedef bool (*Transcoder)(UTF8Kernel kernel, const char* src, size_t len, char32_t* out, size_t* written,
+                           size_t* error_offset);
+
+static bool reference_transcoder(UTF8Kernel kernel, const char* src, size_t len, char32_t* out, size_t* written,
+                                 size_t* error_offset) {
+    (void)kernel;
+    return utf8_transcode_reference(src, len, out, written, error_offset);
+}
+
+typedef struct {
+    Transcoder transcoder;
+    UTF8Kernel kernel;
+    const char* src;
+    size_t len;
+    char32_t* out;  // result of the last run
+    bool valid;
+    size_t written;
+    size_t error_offset;
+} TranscodeBench;
+
+static void run_transcoder(void* context) {
+    TranscodeBench* bench = context;
+    bench->valid =
+        bench->transcoder(bench->kernel, bench->src, bench->len, bench->out, &bench->written, &bench->error_offset);
+}
+
+// run transcoder repeatedly, or once if min_seconds is 0. returns MB/s
+static double bench_transcoder(TranscodeBench* bench, double min_seconds) {
+    return bench->len / seconds_per_run(run_transcoder, bench, min_seconds) / 1e6;
+}
+
+void report_utf8_transcoding(FILE* out, const char* src, size_t len) {
+    char32_t* expected_chars = malloc(sizeof(char32_t) * (len + 1));
+    char32_t* actual = malloc(sizeof(char32_t) * (len + 1));
+    size_t written;
+    // the reference logs the invalid sequence on every run, so invalid input is only compared, not timed
+    double min_seconds = utf8_transcode(src, len, actual, &written, NULL) ? TIMING_MIN_SECONDS : 0;
+    TranscodeBench expected = {.transcoder = reference_transcoder, .src = src, .len = len, .out = expected_chars};
+    double speed = bench_transcoder(&expected, min_seconds);
+    fprintf(out, "%-9s %10.1f MB/s", "reference", speed);
+    if (expected.valid) {
+        fprintf(out, " %zu codepoints\n", expected.written);
+    } else {
+        fprintf(out, " invalid utf8 at byte %zu\n", expected.error_offset);
+    }
+    for (UTF8Kernel kernel = UTF8_SCALAR_KERNEL; kernel < UTF8_KERNEL_COUNT; kernel++) {
+        if (not utf8_kernel_supported(kernel)) {
+            fprintf(out, "%-9s not supported on this cpu\n", utf8_kernel_name(kernel));
+            continue;
+        }
+        TranscodeBench bench = {
+            .transcoder = utf8_transcode_with, .kernel = kernel, .src = src, .len = len, .out = actual};
+        speed = bench_transcoder(&bench, min_seconds);
+        bool matches = bench.valid == expected.valid && bench.written == expected.written &&
+                       bench.error_offset == expected.error_offset &&
+                       memcmp(actual, expected_chars, sizeof(char32_t) * bench.written) == 0;
+        fprintf(out, "%-9s %10.1f MB/s %s%s\n", utf8_kernel_name(kernel), speed, matches ? "matches" : "MISMATCH",
+                kernel == utf8_best_kernel() ? " (selected)" : "");
+    }
+    free(expected_chars);
+    free(actual);
+}
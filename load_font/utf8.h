@@ -0,0 +1,58 @@
+#ifndef LOAD_FONT_UTF8
+#define LOAD_FONT_UTF8
+#include <stddef.h>
+#include <stdio.h>
+#include <uchar.h>
+
+#include "arena.h"
+
+// decodes one codepoint per call. kept as the reference for utf8_transcode
+char32_t cstr_to_codepoint_utf8(const char* cstr, size_t* n_used_cstr);
+char32_t cstr_to_codepoint_native(const char* cstr, size_t* n_used_cstr);
+
+typedef enum {
+    UTF8_SCALAR_KERNEL,  // ascii 8 bytes at a time in a general purpose register. multibyte one by one
+    UTF8_SSE2_KERNEL,    // ascii and runs of two byte sequences 16 bytes at a time
+    UTF8_SSSE3_KERNEL,   // sse2, and runs of three byte sequences 12 bytes at a time
+    UTF8_AVX2_KERNEL,    // ascii, two and three byte runs 32, 32 and 24 bytes at a time
+    UTF8_KERNEL_COUNT,
+} UTF8Kernel;
+
+bool utf8_kernel_supported(UTF8Kernel kernel);
+const char* utf8_kernel_name(UTF8Kernel kernel);
+// fastest kernel the running cpu supports
+UTF8Kernel utf8_best_kernel(void);
+
+/**
+ * @brief transcode len bytes of utf8 into utf32, rejecting overlong forms, surrogates and codepoints over U+10FFFF.
+ * kernels validate and convert runs of ascii, of two byte and of three byte sequences a vector at a time.
+ * four byte sequences, and the vector holding an invalid sequence, are decoded one by one
+ *
+ * @param src doesn't have to be NUL terminated. NUL bytes become U+0000
+ * @param out must have room for len codepoints
+ * @param written set to the number of codepoints written. on failure, those before the invalid sequence
+ * @param error_offset set to byte offset of the first byte of the invalid sequence on failure. can be NULL
+ *
+ * @return true if all of src is valid utf8
+ */
+bool utf8_transcode(const char* src, size_t len, char32_t* out, size_t* written, size_t* error_offset);
+bool utf8_transcode_with(UTF8Kernel kernel, const char* src, size_t len, char32_t* out, size_t* written,
+                         size_t* error_offset);
+
+// same as utf8_transcode, but built on cstr_to_codepoint_utf8. src[len] must be readable and NUL
+bool utf8_transcode_reference(const char* src, size_t len, char32_t* out, size_t* written, size_t* error_offset);
+
+/**
+ * @brief convert NUL terminated string into NUL terminated utf32 string
+ *
+ * @param cstr source string in native encoding
+ * @param utf32_strlen number of codepoints written including the terminating NUL. can be NULL
+ * @param arena receives the utf32 string. it takes arena_size_of(sizeof(char32_t) * (strlen(cstr) + 1))
+ *
+ * @return utf32 string, or NULL if cstr is not valid
+ */
+char32_t* cstr_to_utf32(const char* cstr, size_t* utf32_strlen, Arena* arena);
+
+// print transcoding speed of the reference and every kernel for src, and whether they agree with the reference
+void report_utf8_transcoding(FILE* out, const char* src, size_t len);
+#endif